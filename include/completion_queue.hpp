@@ -0,0 +1,78 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+// Bounded lock-free queue, used by the render threads to hand finished tiles to the main loop without any lock
+// Any number of threads can push and pop at the same time (Dmitry Vyukov's bounded MPMC queue), nothing is allocated after construction
+template <typename T>
+struct CompletionQueue {
+  // The capacity is rounded up to a power of two
+  explicit CompletionQueue(size_t minCapacity) {
+    size_t capacity = 2;
+    while (capacity < minCapacity) { capacity *= 2; }
+    mask = capacity - 1;
+    cells.reset(new Cell[capacity]);
+    for (size_t i = 0; i < capacity; i++) {
+      cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+  CompletionQueue(const CompletionQueue &) = delete;
+  CompletionQueue &operator=(const CompletionQueue &) = delete;
+
+  // False if the queue is full
+  bool push(const T &value) {
+    size_t position = enqueuePosition.load(std::memory_order_relaxed);
+    while (true) {
+      Cell &cell = cells[position & mask];
+      size_t sequence = cell.sequence.load(std::memory_order_acquire);
+      long long difference = (long long) sequence - (long long) position;
+      if (difference == 0) {
+        // The cell is free, claim it
+        if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+          cell.value = value;
+          cell.sequence.store(position + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (difference < 0) {
+        return false;
+      } else {
+        position = enqueuePosition.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // False if the queue is empty
+  bool pop(T &value) {
+    size_t position = dequeuePosition.load(std::memory_order_relaxed);
+    while (true) {
+      Cell &cell = cells[position & mask];
+      size_t sequence = cell.sequence.load(std::memory_order_acquire);
+      long long difference = (long long) sequence - (long long) (position + 1);
+      if (difference == 0) {
+        // The cell holds a value, take it
+        if (dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+          value = cell.value;
+          cell.sequence.store(position + mask + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (difference < 0) {
+        return false;
+      } else {
+        position = dequeuePosition.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  std::unique_ptr<Cell[]> cells;
+  size_t mask;
+  // On their own cache lines, producers and the consumer don't slow each other down
+  alignas(64) std::atomic<size_t> enqueuePosition{0};
+  alignas(64) std::atomic<size_t> dequeuePosition{0};
+};
@@ -0,0 +1,38 @@
+#pragma once
+#include <string>
+
+// Shared-directory work queue, used to split a video between several videogen processes (possibly on several machines)
+// Frames are grouped in chunks, a worker owns a chunk by creating its claim file and keeps it alive (heartbeat) while rendering
+// A chunk whose claim stops receiving heartbeats is handed to the next idle worker
+struct FrameQueue {
+  std::string directory;
+  int frameCount = 0;
+  int chunkSize = 8;
+  // Seconds without heartbeat before a claimed chunk is considered abandoned
+  int staleAfter = 60;
+
+  // Create the queue description, or check that the existing one was made for the same job
+  bool open(const std::string &jobSignature);
+
+  int chunkCount() const;
+  int chunkBegin(int chunk) const;
+  int chunkEnd(int chunk) const; // Exclusive
+
+  // Claim the first chunk nobody is working on (or whose worker stopped sending heartbeats), -1 if there is none
+  int claimChunk();
+  // Find a chunk still in progress, so an idle worker can help finish it, -1 if there is none
+  // Idle workers are spread over the stragglers, the oldest claims first
+  int findStraggler() const;
+
+  void heartbeat(int chunk) const;
+  void markDone(int chunk) const;
+  bool isDone(int chunk) const;
+  bool allDone() const;
+
+  // Host and process id, unique among the workers sharing the directory
+  static std::string getOwnerName();
+
+private:
+  std::string getPath(int chunk, const char *extension) const;
+  bool createClaim(int chunk) const;
+};
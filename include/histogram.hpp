@@ -0,0 +1,55 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <raylib.h>
+#include "sets_definition.hpp"
+
+// Histogram coloring : the palette is spread over the iterations by how many escaped pixels of the view took each of them,
+// so the bands stay readable at high iterations, where n / maxIterations is almost the same everywhere
+// Up to MAX_HISTOGRAM_BINS bins, each one covering the same number of iterations
+const int MAX_HISTOGRAM_BINS = 65536;
+int getHistogramBinCount(float maxIterations);
+
+// Escaped pixels in each bin
+struct IterationHistogram {
+  std::vector<long long> counts;
+};
+
+// Gradient of the histogram coloring, from a position (0 to 1)
+Color getColorFromLevel(float level);
+
+// What a histogram colors the pixels with, shared by the tiles of a view
+struct HistogramPalette {
+  std::vector<float> levels; // Position of the edges of the bins in the gradient (bins + 1) : fraction of the escaped pixels in the bins before
+  std::vector<Color> colors; // Color of the start of each bin
+
+  explicit HistogramPalette(const IterationHistogram &histogram);
+  // Escaped samples only, maxIterations of the view the histogram was counted on (the position is interpolated inside wide bins)
+  float getLevel(const PointSample &sample, float maxIterations) const;
+  Color getColor(const PointSample &sample, float maxIterations) const {
+    if ((int) colors.size() == (int) maxIterations) { return colors[std::min(std::max((int) sample.n, 0), (int) colors.size() - 1)]; }
+    return getColorFromLevel(getLevel(sample, maxIterations));
+  }
+};
+
+// Histograms filled by several threads at once, each one into its own (no lock, and not on the cache lines of the others)
+// They can be reduced while they are still filled, to color the first tiles of a view
+struct HistogramAccumulator {
+  HistogramAccumulator(float maxIterations, int workers);
+  HistogramAccumulator(const HistogramAccumulator &) = delete;
+  HistogramAccumulator &operator=(const HistogramAccumulator &) = delete;
+
+  // Count the escaped samples of a rectangle (rows are stride samples apart), only one thread can add to each worker
+  void add(int worker, const PointSample *samples, int width, int height, int stride);
+  // Sum of the histograms of the workers, with the bins cut in ranges summed by threads threads
+  IterationHistogram reduce(int threads) const;
+
+private:
+  float maxIterations;
+  int bins, workers;
+  size_t stride; // Bins of a worker, rounded up to a whole cache line
+  // Only written by their worker, relaxed so they can be read at the same time
+  std::unique_ptr<std::atomic<unsigned int>[]> counts;
+};
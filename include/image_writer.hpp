@@ -0,0 +1,29 @@
+#pragma once
+#include <string>
+
+// Image encoders for the frames and tiles, from interleaved 8 bit RGB or RGBA rows
+// PNG is the smallest, QOI is lossless and several times faster to encode, PPM and PAM are not compressed at all
+enum ImageFormat {
+  IMAGE_PNG,
+  IMAGE_QOI,
+  IMAGE_PPM, // RGB only, the alpha channel is dropped
+  IMAGE_PAM,
+  IMAGE_FORMAT_COUNT,
+};
+
+const char *getImageFormatName(int format); // Also the file extension
+int getImageFormatFromName(const std::string &name); // -1 if unknown
+
+struct ImageOptions {
+  // 0 stores the pixels without compression (still a valid PNG), 1 to 9 compress more and more slowly (stb_image_write, below 5 is the same as 5)
+  int pngLevel = 8;
+  // Filter applied to every row (0 : none, 1 : sub, 2 : up, 3 : average, 4 : paeth), -1 tries all of them on each row and keeps the best
+  int pngFilter = -1;
+};
+
+// Encode an image (channels : 3 or 4, rows are stride bytes apart) into out, which is overwritten
+bool encodeImage(std::string &out, int format, const unsigned char *data, int width, int height, int channels, int stride,
+                 const ImageOptions &options = ImageOptions());
+// Encode an image into a file
+bool writeImage(const std::string &path, int format, const unsigned char *data, int width, int height, int channels, int stride,
+                const ImageOptions &options = ImageOptions());
@@ -0,0 +1,36 @@
+#pragma once
+#include <atomic>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <vector>
+#include <raylib.h>
+#include "renderer.hpp"
+
+// Low resolution Julia sets for the c values of the Mandelbrot view, to explore the parameter space without leaving it
+// They are computed by the threads of a RenderPool, with interior detection and few iterations, and kept so going back over a point is free
+// Only used from one thread (the pool only marks them done)
+struct JuliaPreviewCache {
+  // Previews of size * size pixels, the capacity least recently used ones are kept
+  JuliaPreviewCache(int size, int capacity) : size(size), capacity(capacity) {}
+  JuliaPreviewCache(const JuliaPreviewCache &) = delete;
+  JuliaPreviewCache &operator=(const JuliaPreviewCache &) = delete;
+
+  // Pixels of the Julia set of c (size * size), nullptr while it is computed
+  // A preview never asked for is submitted to the pool if one of its threads is idle, otherwise on a later call
+  const Color *get(RenderPool &pool, long double re, long double im, float maxIterations);
+  int getSize() const { return size; }
+  int getCount() const { return (int) previews.size(); }
+
+private:
+  struct Preview {
+    std::vector<Color> pixels;
+    std::atomic<bool> done{false};
+    long long lastUsed = 0;
+  };
+  using Key = std::tuple<long double, long double, float>;
+
+  int size, capacity;
+  long long uses = 0;
+  std::map<Key, std::shared_ptr<Preview>> previews;
+};
@@ -0,0 +1,56 @@
+#pragma once
+#include <atomic>
+#include <string>
+#include "sets_definition.hpp"
+
+// High precision orbit of the Mandelbrot set at a fixed center, computed once and shared read-only by every pixel of every frame
+// Pixels then only iterate their (small) offset from it in double precision (perturbation), which is much faster than long double
+// The orbit lives in a fixed memory mapping so it can be extended while other threads read the part that is already published
+struct ReferenceOrbit {
+  struct Point {
+    double x, y;
+  };
+
+  // Orbits longer than this are backed by a file instead of anonymous memory
+  static const int SPILL_THRESHOLD = 1 << 20;
+
+  ReferenceOrbit() = default;
+  ReferenceOrbit(const ReferenceOrbit &) = delete;
+  ReferenceOrbit &operator=(const ReferenceOrbit &) = delete;
+  ~ReferenceOrbit();
+
+  // Reserve room for capacity iterations around (cx, cy), spilling to spillPath if the orbit can get long
+  // An existing spill file for the same center is reused, so a resumed job doesn't recompute its orbit
+  bool open(long double cx, long double cy, int capacity, const std::string &spillPath);
+
+  // Grow the orbit to at least this many iterations (less if the reference escapes), from a single thread
+  void extend(int iterations);
+
+  long double getCenterX() const { return cx; }
+  long double getCenterY() const { return cy; }
+  int size() const { return length.load(std::memory_order_acquire); }
+  const Point *data() const { return points; }
+
+private:
+  // Start of the mapping, also what makes a spill file reusable
+  struct Header {
+    char magic[8];
+    long double cx, cy;
+    long double zx, zy; // Last point at full precision, to continue the orbit
+    int length;
+    int escaped;
+  };
+
+  long double cx = 0, cy = 0;
+  int capacity = 0;
+  std::atomic<int> length{0};
+
+  void *mapping = nullptr;
+  size_t mappingSize = 0;
+  Header *header = nullptr;
+  Point *points = nullptr;
+};
+
+// Mandelbrot point at offset (dx, dy) from the center of the reference orbit, same result as samplePoint_Mandelbrot
+// The offset is re-based on the start of the orbit whenever the pixel gets closer to 0 than to the reference, which avoids glitches
+PointSample samplePoint_MandelbrotPerturbed(const ReferenceOrbit &orbit, double dx, double dy, float maxIterations);
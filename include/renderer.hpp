@@ -0,0 +1,138 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "sets_definition.hpp"
+#include "reference_orbit.hpp"
+
+struct HistogramPalette;
+
+// Headless renderer : a view description in, pixels (and the raw samples if needed) out
+// Used by fractal-viewer and videogen, it never touches a window so it can also run in batch services and tools
+
+// How the pixels are colored
+enum Coloring {
+  COLORING_ITERATIONS, // Palette of each set, from the iterations
+  COLORING_DISTANCE,   // Distance to the set (sets with distance estimation), far regions cost almost nothing
+  COLORING_HISTOGRAM,  // Gradient spread by how many pixels of the view took each iteration count (histogram.hpp), not for Lyapunov
+  COLORING_COUNT,
+};
+const char *getColoringName(int coloring);
+int getColoringFromName(const std::string &name); // -1 if unknown
+
+// What is done with the points inside the set
+enum Interior {
+  INTERIOR_OFF,    // Iterated up to maxIterations
+  INTERIOR_DETECT, // Stopped once their orbit fell in an attracting cycle (sets with interior detection), still drawn black
+  INTERIOR_PERIOD, // Same, colored by the period and the multiplier of the cycle
+  INTERIOR_COUNT,
+};
+const char *getInteriorName(int interior);
+int getInteriorFromName(const std::string &name); // -1 if unknown
+
+// Lanes worth giving to RenderView::lanes for the set in this precision (4 for Lyapunov in float and double, else 1)
+int getPreferredLanes(int set, int precision);
+
+// The whole image the tiles are cut from
+struct RenderView {
+  int set = SET_MANDELBROT;
+  SetParameters parameters; // Julia c and Phoenix p
+  int precision = PRECISION_LONG_DOUBLE;
+  long double cx = 0, cy = 0; // Center of the image
+  long double zoom = 500;     // Pixels per unit
+  int width = 0, height = 0;
+  float maxIterations = 1000;
+  // Mandelbrot is iterated in double around this orbit if set (it must already be extended to maxIterations)
+  const ReferenceOrbit *orbit = nullptr;
+  // Pixels iterated together by the batched kernels (1, 4 or 8)
+  int lanes = 1;
+  // Extra samples spread inside the pixels whose iterations differ from a neighbour, averaged with them (0 : no anti-aliasing)
+  // Not with COLORING_HISTOGRAM, its pixels are colored again from the samples once the histogram of the view is known
+  int aaSamples = 0;
+  // With COLORING_DISTANCE, the reference orbit is not used
+  int coloring = COLORING_ITERATIONS;
+  // Not used with COLORING_DISTANCE or the reference orbit
+  int interior = INTERIOR_OFF;
+  // With COLORING_HISTOGRAM, the palette of the histogram of the view so far (histogram.hpp), without it the gradient follows n / maxIterations
+  std::shared_ptr<const HistogramPalette> histogram;
+};
+
+// Samples of a whole view, kept to seed the next one when zooming in
+struct SampleFrame {
+  RenderView view;
+  std::vector<PointSample> samples; // view.width * view.height, n < 0 where nothing was computed
+};
+
+// A rectangle of the image, and where its result goes
+struct RenderTile {
+  int index = 0, generation = 0; // Not used by the renderer, given back with the result
+  int x = 0, y = 0, width = 0, height = 0;
+  Color *pixels = nullptr;        // width * height, nullptr to only get the samples
+  int stride = 0;                 // Pixels from one row of pixels to the next (0 : width), to render straight into a whole image
+  PointSample *samples = nullptr; // width * height, nullptr if they are not needed
+  int sampleStride = 0;           // Same as stride, for the samples
+  // Older view of the same image, zoomed out : pixels in its uniform areas are only verified on a coarse grid instead of being computed
+  const SampleFrame *previous = nullptr;
+};
+
+struct RenderStats {
+  long long iterations = 0;
+  int pixelsReprojected = 0; // Taken from the previous view without being computed
+  int pixelsAntialiased = 0; // Given aaSamples more samples
+  int pixelsSkipped = 0;     // Proved far from the set by a neighbour (distance estimation)
+  double seconds = 0;
+  int worker = -1;           // Thread of the RenderPool that computed it (0 to getThreadCount() - 1), -1 if not in a pool
+};
+
+// Compute a tile on the calling thread
+RenderStats renderTile(const RenderView &view, const RenderTile &tile);
+// Color the pixels of a tile again from its samples (sampleStride apart), e.g. once the histogram of the view changed, nothing is iterated
+void recolorTile(const RenderView &view, const RenderTile &tile);
+
+// Fill the samples of a tile (width * height) with the nearest ones of an older view, as a placeholder or a prediction
+// uniform (width * height, optional) is set for the pixels whose 3x3 neighbourhood in the older view has the same iterations
+// False if the older view can't predict this one (other set, parameters, iterations or coloring, not zoomed out, Lyapunov)
+bool reprojectTile(const SampleFrame &previous, const RenderView &view, const RenderTile &tile, PointSample *samples, unsigned char *uniform);
+
+// Called from the thread that computed the tile
+using RenderCallback = std::function<void(const RenderView &view, const RenderTile &tile, const RenderStats &stats)>;
+
+// Fixed set of threads computing the submitted tiles in order
+struct RenderPool {
+  explicit RenderPool(int threadCount);
+  // Finishes the submitted tiles first
+  ~RenderPool();
+  RenderPool(const RenderPool &) = delete;
+  RenderPool &operator=(const RenderPool &) = delete;
+
+  void submit(const RenderView &view, const RenderTile &tile, RenderCallback onDone);
+  // Block until every submitted tile is done (and its callback returned)
+  void wait();
+
+  // Tiles submitted and not done yet, queued or being computed
+  int getBusy() const { return busy.load(std::memory_order_acquire); }
+  int getThreadCount() const { return (int) workers.size(); }
+
+private:
+  struct Job {
+    RenderView view;
+    RenderTile tile;
+    RenderCallback onDone;
+  };
+
+  std::vector<std::thread> workers;
+  std::mutex jobsMutex;
+  std::condition_variable jobsChanged; // For the workers
+  std::condition_variable tilesDone;   // For wait()
+  std::deque<Job> jobs;
+  std::atomic<int> busy{0};
+  bool stopping = false;
+
+  void work(int worker);
+};
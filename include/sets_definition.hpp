@@ -1,23 +1,132 @@
 #pragma once
 #include <raylib.h>
+#include <string>
+
+// Every set can be computed in float, double or long double (the more precision, the deeper the zoom but the slower)
+
+// Raw result of iterating a point, kept apart from the coloring so it can be stored, analysed or re-colored
+struct PointSample {
+  float n = 0;          // Iterations done
+  float value = 0;      // Set-specific data used by the coloring (smooth iteration fraction, shading, Lyapunov exponent)
+  bool escaped = false; // Whether the orbit escaped (for Lyapunov, whether it left ]0, 1[, drawn black)
+  unsigned short period = 0; // Period of the attracting cycle found by samplePointInterior, value is then its multiplier (0 if unknown)
+  float distance = 0;   // Estimated distance to the set in world units, only from samplePointDistance (0 if unknown)
+};
+
+// Longest Lyapunov sequence, one bit each
+const int LYAPUNOV_MAX_SEQUENCE = 64;
+
+// Constants of the sets that can be changed at runtime, the defaults are the ones the views and golden images were made with
+struct SetParameters {
+  long double juliaRe = -0.7, juliaIm = 0.27015; // c of the Julia set
+  long double phoenixRe = -0.5, phoenixIm = 0;   // p of the Phoenix set, weight of the iteration before the last one
+  // Lyapunov : which of a (A) or b (B) drives each iteration of the logistic map, repeated. Bit i is set if iteration i of the sequence uses b
+  unsigned long long lyapunovSequence = 0x14; // AABAB
+  int lyapunovLength = 5;
+  int lyapunovWarmup = 0; // Iterations before the exponent is measured, so it doesn't count the orbit settling down (not counted in n either)
+
+  bool operator==(const SetParameters &other) const {
+    return juliaRe == other.juliaRe && juliaIm == other.juliaIm && phoenixRe == other.phoenixRe && phoenixIm == other.phoenixIm &&
+           lyapunovSequence == other.lyapunovSequence && lyapunovLength == other.lyapunovLength && lyapunovWarmup == other.lyapunovWarmup;
+  }
+  bool operator!=(const SetParameters &other) const { return !(*this == other); }
+};
+// "re,im" (or "re im") into a complex parameter, false if it is not two numbers
+bool parseComplex(const std::string &text, long double &re, long double &im);
+// Lyapunov sequence from its letters (A and B, up to LYAPUNOV_MAX_SEQUENCE), false if it is empty or has another letter
+bool parseLyapunovSequence(const std::string &text, SetParameters &parameters);
+std::string getLyapunovSequence(const SetParameters &parameters);
 
 // Mandelbrot
-Color getColorFromPoint_Mandelbrot(long double a, long double b, float maxIterations);
-Color getColorFromPoint_Mandelbrot_LightEffect(long double a, long double b, float maxIterations);
+template <typename Real> PointSample samplePoint_Mandelbrot(Real a, Real b, float maxIterations);
+Color getColorFromSample_Mandelbrot(const PointSample &sample, float maxIterations);
+template <typename Real> PointSample samplePoint_Mandelbrot_LightEffect(Real a, Real b, float maxIterations);
+Color getColorFromSample_Mandelbrot_LightEffect(const PointSample &sample, float maxIterations);
 
 // Julia
-Color getColorFromPoint_Julia(long double a, long double b, float maxIterations);
+template <typename Real> PointSample samplePoint_Julia(Real a, Real b, float maxIterations, const SetParameters &parameters = SetParameters());
+Color getColorFromSample_Julia(const PointSample &sample, float maxIterations);
 
 // Burning ship
-Color getColorFromPoint_BurningShip(long double a, long double b, int maxIterations);
+template <typename Real> PointSample samplePoint_BurningShip(Real a, Real b, float maxIterations);
+Color getColorFromSample_BurningShip(const PointSample &sample, float maxIterations);
 
 // Tricorn
-Color getColorFromPoint_Tricorn(long double a, long double b, int maxIterations);
+template <typename Real> PointSample samplePoint_Tricorn(Real a, Real b, float maxIterations);
+Color getColorFromSample_Tricorn(const PointSample &sample, float maxIterations);
 
 // Phoenix
-Color getColorFromPoint_Phoenix(long double a, long double b, int maxIterations);
+template <typename Real> PointSample samplePoint_Phoenix(Real a, Real b, float maxIterations, const SetParameters &parameters = SetParameters());
+Color getColorFromSample_Phoenix(const PointSample &sample, float maxIterations);
 
 // Lyapunov
-Color getColorFromPoint_Lyapunov(long double a, long double b, int maxIterations);
+template <typename Real> PointSample samplePoint_Lyapunov(Real a, Real b, float maxIterations, const SetParameters &parameters = SetParameters());
+Color getColorFromSample_Lyapunov(const PointSample &sample, float maxIterations);
+
+// Iterate and color in one go
+template <typename Real> Color getColorFromPoint_Mandelbrot(Real a, Real b, float maxIterations) { return getColorFromSample_Mandelbrot(samplePoint_Mandelbrot(a, b, maxIterations), maxIterations); }
+template <typename Real> Color getColorFromPoint_Mandelbrot_LightEffect(Real a, Real b, float maxIterations) { return getColorFromSample_Mandelbrot_LightEffect(samplePoint_Mandelbrot_LightEffect(a, b, maxIterations), maxIterations); }
+template <typename Real> Color getColorFromPoint_Julia(Real a, Real b, float maxIterations, const SetParameters &parameters = SetParameters()) { return getColorFromSample_Julia(samplePoint_Julia(a, b, maxIterations, parameters), maxIterations); }
+template <typename Real> Color getColorFromPoint_BurningShip(Real a, Real b, float maxIterations) { return getColorFromSample_BurningShip(samplePoint_BurningShip(a, b, maxIterations), maxIterations); }
+template <typename Real> Color getColorFromPoint_Tricorn(Real a, Real b, float maxIterations) { return getColorFromSample_Tricorn(samplePoint_Tricorn(a, b, maxIterations), maxIterations); }
+template <typename Real> Color getColorFromPoint_Phoenix(Real a, Real b, float maxIterations, const SetParameters &parameters = SetParameters()) { return getColorFromSample_Phoenix(samplePoint_Phoenix(a, b, maxIterations, parameters), maxIterations); }
+template <typename Real> Color getColorFromPoint_Lyapunov(Real a, Real b, float maxIterations, const SetParameters &parameters = SetParameters()) { return getColorFromSample_Lyapunov(samplePoint_Lyapunov(a, b, maxIterations, parameters), maxIterations); }
+
+
+// Sets by number (same order as the --set flag)
+enum Set {
+  SET_MANDELBROT = 0,
+  SET_JULIA,
+  SET_BURNING_SHIP,
+  SET_TRICORN,
+  SET_PHOENIX,
+  SET_LYAPUNOV,
+  SET_MANDELBROT_LIGHT_EFFECT,
+  SET_COUNT
+};
+const char *getSetName(int set);
+// Accepts the name or the number of the set, -1 if unknown
+int getSetFromName(const std::string &name);
+
+// Compute any set from its number (the parameters are only used by the sets they belong to)
+template <typename Real> PointSample samplePoint(int set, Real a, Real b, float maxIterations, const SetParameters &parameters = SetParameters());
+Color getColorFromSample(int set, const PointSample &sample, float maxIterations);
+template <typename Real> Color getColorFromPoint(int set, Real a, Real b, float maxIterations, const SetParameters &parameters = SetParameters());
+
+// Sample count points at once, iterating groups of lanes points together (1, 4 or 8) so the compiler can vectorize them
+// Only Mandelbrot, Burning ship, Tricorn and Lyapunov have a batched path, the other sets are sampled one by one
+template <typename Real> void samplePoints(int set, const Real *a, const Real *b, PointSample *samples, int count, float maxIterations, int lanes,
+                                          const SetParameters &parameters = SetParameters());
+
+
+// Distance estimation : the orbit is followed with its derivative, which gives a lower estimate of the distance to the set
+// Mandelbrot (also for the light effect), Julia, Burning ship and Tricorn, the other sets are sampled normally (distance 0)
+// The iterations don't match samplePoint, the escape radius is much bigger so the estimate is accurate
+template <typename Real> PointSample samplePointDistance(int set, Real a, Real b, float maxIterations, const SetParameters &parameters = SetParameters());
+bool hasDistanceEstimation(int set);
+// Black inside, white far from the set, and a gradient over the last DISTANCE_FADE pixels before the boundary (zoom : pixels per unit)
+const float DISTANCE_FADE = 4;
+Color getColorFromDistance(const PointSample &sample, long double zoom);
+
+
+// Interior detection : the orbit is checked for a cycle (Brent), and it is stopped once it came back to a cycle whose multiplier
+// (derivative of the orbit over one period) is below 1, so the points inside the set don't run up to maxIterations
+// Mandelbrot, its light effect and Julia, the other sets are sampled normally. The escaped points are the same as with samplePoint
+template <typename Real> PointSample samplePointInterior(int set, Real a, Real b, float maxIterations, const SetParameters &parameters = SetParameters());
+bool hasInteriorDetection(int set);
+// Hue from the period, brighter near the center of the cycle (multiplier 0), black if no cycle was found
+Color getColorFromInterior(const PointSample &sample);
+
 
+// Floating point type used to compute the sets
+enum Precision {
+  PRECISION_FLOAT = 0,
+  PRECISION_DOUBLE,
+  PRECISION_LONG_DOUBLE,
+  PRECISION_COUNT
+};
+const char *getPrecisionName(int precision);
+int getPrecisionFromName(const std::string &name); // -1 if unknown
 
+// Whether the precision can still tell apart neighbouring pixels at this position and zoom
+bool isPrecisionEnough(int precision, long double x, long double y, long double zoom);
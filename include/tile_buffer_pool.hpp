@@ -0,0 +1,40 @@
+#pragma once
+#include <mutex>
+#include <vector>
+#include <raylib.h>
+
+// Fixed set of tile pixel buffers, allocated once so rendering allocates nothing and memory stays bounded
+// A buffer goes free -> in use (being computed) -> ready (waiting to be uploaded) -> cached (kept by the tile cache) -> free
+// It can be released from any state, e.g. when a newer generation of the tile lands before it is uploaded
+struct TileBufferPool {
+  enum State {
+    FREE,
+    IN_USE,
+    READY,
+    CACHED,
+    STATE_COUNT,
+  };
+
+  TileBufferPool(int bufferCount, int pixelsPerBuffer);
+  TileBufferPool(const TileBufferPool &) = delete;
+  TileBufferPool &operator=(const TileBufferPool &) = delete;
+
+  // A free buffer (now in use), nullptr if they are all taken
+  Color *acquire();
+  void markReady(Color *buffer);
+  void markCached(Color *buffer);
+  void release(Color *buffer);
+
+  int getCount(State state);
+  int getBufferCount() const { return (int) states.size(); }
+
+private:
+  int pixelsPerBuffer;
+  std::vector<Color> pixels; // Every buffer, one after the other
+  std::mutex mutex;
+  std::vector<State> states;
+  std::vector<int> freeBuffers;
+
+  int getIndex(const Color *buffer) const;
+  void setState(Color *buffer, State from, State to);
+};
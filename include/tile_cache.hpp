@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <raylib.h>
+#include "sets_definition.hpp"
+
+// Everything the pixels of a tile depend on
+struct TileKey {
+  int set;
+  int index;
+  float maxIterations;
+  long double cx, cy, cz;
+  int coloring = 0;
+  int interior = 0;
+  SetParameters parameters;
+
+  bool operator==(const TileKey &other) const {
+    return set == other.set && index == other.index && maxIterations == other.maxIterations && cx == other.cx && cy == other.cy && cz == other.cz &&
+           coloring == other.coloring && interior == other.interior && parameters == other.parameters;
+  }
+};
+
+struct TileKeyHash {
+  size_t operator()(const TileKey &key) const;
+};
+
+// Recently computed tiles, so going back to a view (other set, other iterations, reset...) doesn't compute it again
+// Least recently used tiles are dropped first, only used from one thread
+struct TileCache {
+  // Dropped pixels are given to release (delete[] if not set), so they can come from a pool
+  TileCache(int capacity, std::function<void(Color *)> release = nullptr) : capacity(capacity), release(release) {}
+  ~TileCache();
+  TileCache(const TileCache &) = delete;
+  TileCache &operator=(const TileCache &) = delete;
+
+  // Pixels of the tile (valid until the next put), nullptr if they are not cached
+  const Color *find(const TileKey &key);
+  // Same as find, without counting a hit or a miss and without touching the order
+  bool contains(const TileKey &key) const { return lookup.find(key) != lookup.end(); }
+  // Keep these pixels, the cache now owns them until they are dropped
+  void put(const TileKey &key, Color *pixels);
+
+  int hits = 0, misses = 0;
+
+private:
+  struct Entry {
+    TileKey key;
+    Color *pixels;
+  };
+
+  int capacity;
+  std::function<void(Color *)> release;
+  std::list<Entry> entries; // Most recently used first
+  std::unordered_map<TileKey, std::list<Entry>::iterator, TileKeyHash> lookup;
+
+  void drop(Color *pixels);
+};
@@ -0,0 +1,65 @@
+#pragma once
+#include <unordered_set>
+#include <vector>
+
+// Everything a thread needs to compute a tile, frozen when the tile was scheduled
+struct PendingTile {
+  int index;
+  long double cx, cy, cz;
+  int generation;
+  float maxIterations;
+};
+
+// Where the user is looking and how the camera moves, in tiles (the screen goes from (0, 0) to (tilesX, tilesY))
+struct TileFocus {
+  float x, y;               // Usually the cursor, or the centre of the screen
+  float velocityX = 0;      // Camera movement, in tiles per second
+  float velocityY = 0;
+  float zoomRate = 0;       // Natural log of the zoom factor per second (> 0 when zooming in)
+};
+
+// Order in which the tiles of a new view are computed, shared by fractal-viewer and the headless render benchmark
+// Tiles are only queued here, the caller decides how many threads take them and when
+struct TileScheduler {
+  TileScheduler(int tilesX, int tilesY);
+
+  // Should be set to true, avoids unnecessary re-renders of the same tile (a newer request replaces the queued one)
+  bool avoidDuplicates = true;
+  // Take the tiles closest to the focus first (where they will be once the camera moved a bit), and the newest view before any older one
+  // If false, the tiles are computed in the order they were queued
+  bool prioritizeFocus = false;
+
+  // Reorders the queued tiles, can be called every frame
+  void setFocus(const TileFocus &focus);
+
+  // Queue every tile of a view, in a spiral if only zooming, else starting from the side the camera is moving to (ties when prioritizing the focus)
+  // (diffX, diffY) is the previous camera position minus the new one
+  void scheduleView(long double cx, long double cy, long double cz, int generation, float maxIterations, long double diffX, long double diffY);
+
+  // Take the next tile to compute, false if the queue is empty
+  bool pop(PendingTile &tile);
+  // Forget every queued tile
+  void clear();
+
+  bool empty() const { return pendingTiles.empty(); }
+  int size() const { return (int) pendingTiles.size(); }
+
+private:
+  struct QueuedTile {
+    PendingTile tile;
+    float priority; // Lower is sooner
+    long long order;
+  };
+
+  int tilesX, tilesY;
+  std::vector<int> spiralIndicesOutward;
+  TileFocus focus;
+  // Heap, the next tile to compute is at the front
+  std::vector<QueuedTile> pendingTiles;
+  std::unordered_set<int> tilesScheduled; // To avoid duplicates in queue
+  long long tilesQueued = 0;
+
+  void scheduleTile(const PendingTile &tile);
+  float getPriority(int index) const;
+  bool isLater(const QueuedTile &a, const QueuedTile &b) const;
+};
@@ -0,0 +1,43 @@
+#pragma once
+#include <string>
+
+// Optional timeline of what the tiles went through (queued, started, computed, uploaded...), written as a Chrome trace
+// Open the file in chrome://tracing or https://ui.perfetto.dev
+// Each thread records into its own ring buffer without locking, only the most recent events of each buffer are kept
+// Names must be string literals (only the pointer is stored)
+
+// Start recording, the trace is written to path by writeTrace()
+void startTrace(const std::string &path);
+// Write every recorded event, can be called while other threads are still recording
+bool writeTrace();
+
+extern bool tracing;
+inline bool isTracing() { return tracing; }
+
+// Microseconds since the trace started
+double getTraceTime();
+
+// Event at a single point in time (tile and generation are -1 if not relevant)
+void traceInstant(const char *name, int tile, int generation);
+// Event with a duration
+void traceComplete(const char *name, int tile, int generation, double start, double end);
+// Name of the calling thread in the trace
+void traceThreadName(const char *name);
+
+// Records the time between its creation and its destruction
+struct TraceScope {
+  TraceScope(const char *name, int tile, int generation) : name(name), tile(tile), generation(generation) {
+    if (tracing) { start = getTraceTime(); }
+  }
+  ~TraceScope() {
+    if (tracing) { traceComplete(name, tile, generation, start, getTraceTime()); }
+  }
+
+  TraceScope(const TraceScope &) = delete;
+  TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+  const char *name;
+  int tile, generation;
+  double start = 0;
+};
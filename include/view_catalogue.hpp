@@ -0,0 +1,12 @@
+#pragma once
+#include "sets_definition.hpp"
+
+// Fixed views of every set, used to benchmark the kernels and to check that they still render the same thing
+// Shallow exterior, boundary, interior-heavy and deep zoom, for each set (same order as the Set enum)
+struct CatalogueView {
+  const char *name;
+  long double x, y, zoom;
+};
+const int CATALOGUE_VIEW_COUNT = 4;
+
+extern const CatalogueView viewCatalogue[SET_COUNT][CATALOGUE_VIEW_COUNT];
@@ -0,0 +1,203 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+
+// Own implementations
+#include "sets_definition.hpp"
+#include "reference_orbit.hpp"
+#include "view_catalogue.hpp"
+
+
+// Constants (changeable with flags)
+int WIDTH = 256;
+int HEIGHT = 144;
+int MAX_ITERATIONS = 1000;
+// Each measure is repeated, and the fastest run is kept
+int REPEAT = 3;
+// Only benchmark this set (-1 : all of them)
+int ONLY_SET = -1;
+// Where to write the results for trend tracking (nothing if empty)
+std::string JSON_PATH = "";
+
+struct Result {
+  std::string set, view, precision;
+  int lanes;
+  double seconds;
+  double iterations;
+  double pixelsPerSecond, iterationsPerSecond;
+};
+
+// Pixel coordinates of a view, in the precision being measured
+template <typename Real>
+void getViewPoints(const CatalogueView &view, std::vector<Real> &a, std::vector<Real> &b) {
+  a.resize(WIDTH * HEIGHT);
+  b.resize(WIDTH * HEIGHT);
+  for (int j = 0; j < HEIGHT; j++) {
+    for (int i = 0; i < WIDTH; i++) {
+      a[j * WIDTH + i] = (Real) ((i - WIDTH / 2.0L) / view.zoom + view.x);
+      b[j * WIDTH + i] = (Real) ((j - HEIGHT / 2.0L) / view.zoom + view.y);
+    }
+  }
+}
+
+// Time a kernel, keeping the fastest of the runs
+template <typename Kernel>
+Result measure(Kernel kernel, std::vector<PointSample> &samples) {
+  Result result;
+  result.seconds = 1e30;
+  for (int run = 0; run < REPEAT; run++) {
+    auto start = std::chrono::steady_clock::now();
+    kernel();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.seconds = std::min(result.seconds, seconds);
+  }
+
+  result.iterations = 0;
+  for (const PointSample &sample : samples) { result.iterations += sample.n; }
+  result.pixelsPerSecond = samples.size() / result.seconds;
+  result.iterationsPerSecond = result.iterations / result.seconds;
+  return result;
+}
+
+template <typename Real>
+Result measureSet(int set, const CatalogueView &view, int lanes) {
+  std::vector<Real> a, b;
+  getViewPoints(view, a, b);
+  std::vector<PointSample> samples(a.size());
+  return measure([&]() { samplePoints(set, a.data(), b.data(), samples.data(), (int) samples.size(), MAX_ITERATIONS, lanes); }, samples);
+}
+
+// Points inside the set stopped once their orbit fell in a cycle
+template <typename Real>
+Result measureInterior(int set, const CatalogueView &view) {
+  std::vector<Real> a, b;
+  getViewPoints(view, a, b);
+  std::vector<PointSample> samples(a.size());
+  return measure([&]() {
+    for (size_t p = 0; p < samples.size(); p++) { samples[p] = samplePointInterior(set, a[p], b[p], MAX_ITERATIONS); }
+  }, samples);
+}
+
+// Mandelbrot iterated in double around a reference orbit at the center of the view
+Result measurePerturbed(const CatalogueView &view) {
+  ReferenceOrbit orbit;
+  orbit.open(view.x, view.y, MAX_ITERATIONS, "");
+  orbit.extend(MAX_ITERATIONS);
+
+  std::vector<PointSample> samples(WIDTH * HEIGHT);
+  return measure([&]() {
+    for (int j = 0; j < HEIGHT; j++) {
+      for (int i = 0; i < WIDTH; i++) {
+        double dx = (i - WIDTH / 2.0) / (double) view.zoom;
+        double dy = (j - HEIGHT / 2.0) / (double) view.zoom;
+        samples[j * WIDTH + i] = samplePoint_MandelbrotPerturbed(orbit, dx, dy, MAX_ITERATIONS);
+      }
+    }
+  }, samples);
+}
+
+void printResult(const Result &result) {
+  printf("%-17s %-17s %-12s %5d %10.2f %10.3f %10.3f\n", result.set.c_str(), result.view.c_str(), result.precision.c_str(), result.lanes,
+         result.seconds * 1000, result.pixelsPerSecond / 1e6, result.iterationsPerSecond / 1e9);
+  fflush(stdout);
+}
+
+bool writeJson(const std::vector<Result> &results) {
+  std::ofstream file(JSON_PATH);
+  if (!file.is_open()) { return false; }
+
+  file << "{\n";
+  file << "  \"benchmark\": \"fractal-bench\",\n";
+  file << "  \"width\": " << WIDTH << ",\n  \"height\": " << HEIGHT << ",\n";
+  file << "  \"maxIterations\": " << MAX_ITERATIONS << ",\n  \"repeat\": " << REPEAT << ",\n";
+  file << "  \"results\": [\n";
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result &result = results[i];
+    file << "    {\"set\": \"" << result.set << "\", \"view\": \"" << result.view << "\", \"precision\": \"" << result.precision << "\", ";
+    file << "\"lanes\": " << result.lanes << ", \"seconds\": " << result.seconds << ", \"iterations\": " << result.iterations << ", ";
+    file << "\"pixelsPerSecond\": " << result.pixelsPerSecond << ", \"iterationsPerSecond\": " << result.iterationsPerSecond << "}";
+    file << (i + 1 < results.size() ? ",\n" : "\n");
+  }
+  file << "  ]\n}\n";
+  return file.good();
+}
+
+
+// Main function
+int main(int argc, char *argv[]) {
+  // Replace constants by the ones given in the flags (if present)
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--width") {
+      WIDTH = std::stoi(argv[++i]);
+    } else if (arg == "--height") {
+      HEIGHT = std::stoi(argv[++i]);
+    } else if (arg == "--it") {
+      MAX_ITERATIONS = std::stoi(argv[++i]);
+    } else if (arg == "--repeat") {
+      REPEAT = std::max(1, std::stoi(argv[++i]));
+    } else if (arg == "--set") {
+      ONLY_SET = getSetFromName(argv[++i]);
+      if (ONLY_SET < 0) {
+        std::cerr << "Unknown set " << argv[i] << std::endl;
+        return 1;
+      }
+    } else if (arg == "--json") {
+      JSON_PATH = argv[++i];
+    }
+  }
+
+  printf("%-17s %-17s %-12s %5s %10s %10s %10s\n", "set", "view", "precision", "lanes", "ms", "Mpix/s", "Giter/s");
+  std::vector<Result> results;
+  auto addResult = [&results](Result result, int set, const CatalogueView &view, const char *precision, int lanes) {
+    result.set = getSetName(set);
+    result.view = view.name;
+    result.precision = precision;
+    result.lanes = lanes;
+    printResult(result);
+    results.push_back(result);
+  };
+
+  for (int set = 0; set < SET_COUNT; set++) {
+    if (ONLY_SET >= 0 && set != ONLY_SET) { continue; }
+    // Only these sets have a batched path, measuring the others with more lanes would measure the same thing
+    bool batched = set == SET_MANDELBROT || set == SET_BURNING_SHIP || set == SET_TRICORN || set == SET_LYAPUNOV;
+
+    for (const CatalogueView &view : viewCatalogue[set]) {
+      for (int precision = 0; precision < PRECISION_COUNT; precision++) {
+        // A precision that can't resolve the view would measure garbage
+        if (!isPrecisionEnough(precision, view.x, view.y, view.zoom)) { continue; }
+
+        for (int lanes : {1, 4, 8}) {
+          if (lanes > 1 && !batched) { break; }
+          Result result;
+          switch (precision) {
+            case PRECISION_FLOAT: result = measureSet<float>(set, view, lanes); break;
+            case PRECISION_DOUBLE: result = measureSet<double>(set, view, lanes); break;
+            default: result = measureSet<long double>(set, view, lanes); break;
+          }
+          addResult(result, set, view, getPrecisionName(precision), lanes);
+        }
+      }
+
+      if (set == SET_MANDELBROT) {
+        addResult(measurePerturbed(view), set, view, "perturbed", 1);
+      }
+      if (hasInteriorDetection(set) && isPrecisionEnough(PRECISION_DOUBLE, view.x, view.y, view.zoom)) {
+        addResult(measureInterior<double>(set, view), set, view, "interior", 1);
+      }
+    }
+  }
+
+  if (!JSON_PATH.empty()) {
+    if (!writeJson(results)) {
+      std::cerr << "Could not write " << JSON_PATH << std::endl;
+      return 1;
+    }
+    std::cout << "Results written to " << JSON_PATH << std::endl;
+  }
+  return 0;
+}
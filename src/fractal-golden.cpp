@@ -0,0 +1,253 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Own implementations
+#include "sets_definition.hpp"
+#include "tile_scheduler.hpp"
+#include "view_catalogue.hpp"
+#include "renderer.hpp"
+
+
+// Constants (changeable with flags)
+// record : renders every view of the catalogue and stores the result as golden data
+// check : renders them again and compares them with the golden data (exit code 1 if any differs)
+std::string MODE = "";
+std::string GOLDEN_DIR = "golden";
+// Size and iterations of the recorded views (check uses the ones of the golden data)
+int WIDTH = 48;
+int HEIGHT = 27;
+int MAX_ITERATIONS = 500;
+// Rendered like fractal-viewer : cut in tiles, computed in the order of the scheduler by several threads
+const int TILES_X = 16;
+const int TILES_Y = 9;
+// Precision recorded or checked (each has its own golden data, always recorded with the scalar kernels), and lanes checked
+int PRECISION = PRECISION_LONG_DOUBLE;
+int LANES = 1;
+int ONLY_SET = -1;
+// A pixel differs if its iterations differ by more than ITERATION_TOLERANCE, its escape by anything, or its value by more than VALUE_TOLERANCE
+// A view fails if more than MAX_MISMATCH of its pixels differ (chaotic pixels of the boundary are allowed to move a little)
+float ITERATION_TOLERANCE = 1;
+float VALUE_TOLERANCE = 0.01f;
+float MAX_MISMATCH = 0.002f;
+
+const char *GOLDEN_MAGIC = "fractal-golden 1";
+
+std::vector<PointSample> renderView(int set, const CatalogueView &view, int width, int height, float maxIterations) {
+  std::vector<PointSample> samples(width * height);
+  TileScheduler scheduler(TILES_X, TILES_Y);
+  scheduler.scheduleView(view.x, view.y, view.zoom, 0, maxIterations, 0, 0);
+
+  // Same renderer as fractal-viewer, the batched kernels are checked too when LANES is set
+  RenderView renderView;
+  renderView.set = set;
+  renderView.precision = PRECISION;
+  renderView.cx = view.x;
+  renderView.cy = view.y;
+  renderView.zoom = view.zoom;
+  renderView.width = width;
+  renderView.height = height;
+  renderView.maxIterations = maxIterations;
+  renderView.lanes = LANES;
+
+  int tileWidth = width / TILES_X;
+  int tileHeight = height / TILES_Y;
+  std::vector<PointSample> tileSamples(TILES_X * TILES_Y * tileWidth * tileHeight);
+  RenderPool renderPool(std::max(1u, std::thread::hardware_concurrency()));
+  PendingTile next;
+  while (scheduler.pop(next)) {
+    RenderTile tile;
+    tile.index = next.index;
+    tile.x = (next.index % TILES_X) * tileWidth;
+    tile.y = (next.index / TILES_X) * tileHeight;
+    tile.width = tileWidth;
+    tile.height = tileHeight;
+    tile.samples = &tileSamples[next.index * tileWidth * tileHeight];
+    renderPool.submit(renderView, tile, nullptr);
+  }
+  renderPool.wait();
+
+  // Put the tiles back together
+  for (int index = 0; index < TILES_X * TILES_Y; index++) {
+    int x = (index % TILES_X) * tileWidth;
+    int y = (index / TILES_X) * tileHeight;
+    for (int j = 0; j < tileHeight; j++) {
+      const PointSample *row = &tileSamples[(index * tileHeight + j) * tileWidth];
+      std::copy(row, row + tileWidth, &samples[(y + j) * width + x]);
+    }
+  }
+  return samples;
+}
+
+// Long double data has no precision in its name, it was the only one recorded at first
+std::string getGoldenPath(int set, const CatalogueView &view) {
+  std::string precision = PRECISION == PRECISION_LONG_DOUBLE ? "" : std::string(".") + getPrecisionName(PRECISION);
+  return GOLDEN_DIR + "/" + getSetName(set) + "-" + view.name + precision + ".golden";
+}
+
+// One text line describing the view (and the precision it was rendered in), then for each pixel : iterations (uint16), escaped (uint8) and value (float32), little endian
+bool writeGolden(const std::string &path, int set, const CatalogueView &view, const std::vector<PointSample> &samples) {
+  std::ofstream file(path, std::ios::binary);
+  file << GOLDEN_MAGIC << " " << getSetName(set) << " " << view.name << " " << WIDTH << " " << HEIGHT << " " << MAX_ITERATIONS << " "
+       << getPrecisionName(PRECISION) << "\n";
+  for (const PointSample &sample : samples) {
+    uint16_t n = (uint16_t) std::lround(sample.n);
+    uint8_t escaped = sample.escaped;
+    unsigned char pixel[7];
+    pixel[0] = n & 0xff;
+    pixel[1] = n >> 8;
+    pixel[2] = escaped;
+    memcpy(pixel + 3, &sample.value, 4);
+    file.write((const char *) pixel, sizeof(pixel));
+  }
+  return file.good();
+}
+
+bool readGolden(const std::string &path, int &width, int &height, int &maxIterations, int &precision, std::vector<PointSample> &samples) {
+  std::ifstream file(path, std::ios::binary);
+  std::string header;
+  if (!std::getline(file, header) || header.compare(0, strlen(GOLDEN_MAGIC), GOLDEN_MAGIC) != 0) { return false; }
+
+  std::stringstream values(header.substr(strlen(GOLDEN_MAGIC)));
+  std::string set, view;
+  if (!(values >> set >> view >> width >> height >> maxIterations) || width <= 0 || height <= 0) { return false; }
+  // Data recorded before the precision was written is in long double
+  std::string precisionName;
+  precision = values >> precisionName ? getPrecisionFromName(precisionName) : PRECISION_LONG_DOUBLE;
+
+  samples.resize(width * height);
+  for (PointSample &sample : samples) {
+    unsigned char pixel[7];
+    if (!file.read((char *) pixel, sizeof(pixel))) { return false; }
+    sample.n = pixel[0] | (pixel[1] << 8);
+    sample.escaped = pixel[2] != 0;
+    memcpy(&sample.value, pixel + 3, 4);
+  }
+  return true;
+}
+
+// Compare a view with its golden data, false if it differs too much
+bool checkView(int set, const CatalogueView &view) {
+  int width, height, maxIterations, precision;
+  std::vector<PointSample> golden;
+  if (!readGolden(getGoldenPath(set, view), width, height, maxIterations, precision, golden)) {
+    printf("FAIL %-13s %-17s missing or invalid %s (record it with the same --precision)\n", getSetName(set), view.name,
+           getGoldenPath(set, view).c_str());
+    return false;
+  }
+  if (precision != PRECISION) {
+    printf("FAIL %-13s %-17s %s was recorded in %s\n", getSetName(set), view.name, getGoldenPath(set, view).c_str(), getPrecisionName(precision));
+    return false;
+  }
+
+  std::vector<PointSample> samples = renderView(set, view, width, height, maxIterations);
+  int mismatches = 0;
+  float maxIterationDiff = 0;
+  for (size_t i = 0; i < samples.size(); i++) {
+    float iterationDiff = std::abs(std::round(samples[i].n) - golden[i].n);
+    float valueDiff = std::abs(samples[i].value - golden[i].value);
+    maxIterationDiff = std::max(maxIterationDiff, iterationDiff);
+    if (iterationDiff > ITERATION_TOLERANCE || samples[i].escaped != golden[i].escaped || !(valueDiff <= VALUE_TOLERANCE)) {
+      mismatches++;
+    }
+  }
+
+  bool passed = mismatches <= MAX_MISMATCH * samples.size();
+  printf("%s %-13s %-17s %d / %d pixels differ, max iteration difference %.0f\n", passed ? "ok  " : "FAIL", getSetName(set), view.name,
+         mismatches, (int) samples.size(), maxIterationDiff);
+  return passed;
+}
+
+
+// Main function
+int main(int argc, char *argv[]) {
+  // Replace constants by the ones given in the flags (if present)
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "record" || arg == "check") {
+      MODE = arg;
+    } else if (arg == "--dir") {
+      GOLDEN_DIR = argv[++i];
+    } else if (arg == "--width") {
+      WIDTH = std::stoi(argv[++i]);
+    } else if (arg == "--height") {
+      HEIGHT = std::stoi(argv[++i]);
+    } else if (arg == "--it") {
+      MAX_ITERATIONS = std::stoi(argv[++i]);
+    } else if (arg == "--precision") {
+      PRECISION = getPrecisionFromName(argv[++i]);
+      if (PRECISION < 0) {
+        std::cerr << "Unknown precision " << argv[i] << std::endl;
+        return 1;
+      }
+    } else if (arg == "--lanes") {
+      LANES = std::stoi(argv[++i]);
+    } else if (arg == "--set") {
+      ONLY_SET = getSetFromName(argv[++i]);
+      if (ONLY_SET < 0) {
+        std::cerr << "Unknown set " << argv[i] << std::endl;
+        return 1;
+      }
+    } else if (arg == "--tolerance") {
+      ITERATION_TOLERANCE = std::stof(argv[++i]);
+    } else if (arg == "--value-tolerance") {
+      VALUE_TOLERANCE = std::stof(argv[++i]);
+    } else if (arg == "--max-mismatch") {
+      MAX_MISMATCH = std::stof(argv[++i]);
+    } else {
+      std::cerr << "Unknown flag " << arg << std::endl;
+      return 1;
+    }
+  }
+
+  if (MODE.empty()) {
+    std::cerr << "Usage: fractal-golden record|check [flags]" << std::endl;
+    return 1;
+  }
+  if (WIDTH % TILES_X != 0 || HEIGHT % TILES_Y != 0) {
+    std::cerr << "The size must be a multiple of the " << TILES_X << "x" << TILES_Y << " tiles" << std::endl;
+    return 1;
+  }
+
+  // The reference of each precision is its scalar rendering, the batched kernels are checked against it
+  if (MODE == "record") {
+    LANES = 1;
+  }
+
+  int failures = 0;
+  for (int set = 0; set < SET_COUNT; set++) {
+    if (ONLY_SET >= 0 && set != ONLY_SET) { continue; }
+
+    for (const CatalogueView &view : viewCatalogue[set]) {
+      // A precision that can't resolve the view would never match (nor make a useful reference)
+      if (!isPrecisionEnough(PRECISION, view.x, view.y, view.zoom)) {
+        printf("skip %-13s %-17s not enough precision\n", getSetName(set), view.name);
+        continue;
+      }
+
+      if (MODE == "record") {
+        std::string path = getGoldenPath(set, view);
+        if (!writeGolden(path, set, view, renderView(set, view, WIDTH, HEIGHT, MAX_ITERATIONS))) {
+          std::cerr << "Could not write " << path << ", does " << GOLDEN_DIR << " exist?" << std::endl;
+          return 1;
+        }
+        std::cout << "Recorded " << path << std::endl;
+        continue;
+      }
+      if (!checkView(set, view)) { failures++; }
+    }
+  }
+
+  if (MODE == "check") {
+    std::cout << (failures == 0 ? "All views match" : std::to_string(failures) + " view(s) differ") << std::endl;
+  }
+  return failures == 0 ? 0 : 1;
+}
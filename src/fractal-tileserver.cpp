@@ -0,0 +1,470 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+// Own implementations
+#include "sets_definition.hpp"
+#include "tile_cache.hpp"
+#include "renderer.hpp"
+#include "image_writer.hpp"
+
+
+// Constants (changeable with flags)
+std::string HOST = "127.0.0.1";
+int PORT = 8080;
+// Set served by /z/x/y.png (other sets are served by /set/z/x/y.png)
+int SET = 0;
+int TILE_SIZE = 256;
+// Iterations of the tiles of level 0, and how many are added at each level
+int BASE_ITERATIONS = 500;
+int ITERATIONS_PER_LEVEL = 100;
+// Precision of the tiles, -1 : the fastest one that can resolve the tile
+int PRECISION = -1;
+int THREADS = std::max(1u, std::thread::hardware_concurrency());
+// PNG compression of the tiles (level 0 to 9, filter -1 to 4, see image_writer.hpp)
+ImageOptions PNG_OPTIONS;
+// How many computed tiles are kept in memory
+int CACHE_SIZE = 4096;
+
+// The world is the square [-2, 2] x [-2, 2], level z cuts it in 2^z x 2^z tiles (y goes down, like the viewer)
+const long double WORLD_SIZE = 4;
+const int MAX_LEVEL = 60;
+// Pending tiles of another level than the viewport are served after the ones this many tiles away from its center
+const double LEVEL_PENALTY = 2;
+
+// Where a tile is, and what it is computed with
+struct TileAddress {
+  int set;
+  int z;
+  long long x, y;
+  float maxIterations;
+  long double cx, cy, zoom;
+
+  // Tiles are rendered with the default coloring, interior and parameters
+  TileKey getKey() const { return {set, z, maxIterations, cx, cy, zoom, COLORING_ITERATIONS, INTERIOR_OFF, SetParameters()}; }
+};
+
+// A tile being computed, every request for it waits for the same result
+struct TileRequest {
+  TileAddress address;
+  bool done = false;
+  std::shared_ptr<const std::string> png;
+};
+
+// Recently served tiles, already encoded : a hit costs no encoding (only used with serverMutex locked)
+// Least recently used tiles are dropped first
+struct PngCache {
+  explicit PngCache(int capacity) : capacity(capacity) {}
+
+  // nullptr if the tile is not cached
+  std::shared_ptr<const std::string> find(const TileKey &key) {
+    auto found = lookup.find(key);
+    if (found == lookup.end()) {
+      misses++;
+      return nullptr;
+    }
+    hits++;
+    entries.splice(entries.begin(), entries, found->second);
+    return found->second->second;
+  }
+
+  void put(const TileKey &key, std::shared_ptr<const std::string> png) {
+    auto found = lookup.find(key);
+    if (found != lookup.end()) {
+      entries.erase(found->second);
+      lookup.erase(found);
+    }
+    entries.emplace_front(key, std::move(png));
+    lookup[key] = entries.begin();
+    while ((int) entries.size() > capacity) {
+      lookup.erase(entries.back().first);
+      entries.pop_back();
+    }
+  }
+
+  int hits = 0, misses = 0;
+
+private:
+  int capacity;
+  std::list<std::pair<TileKey, std::shared_ptr<const std::string>>> entries; // Most recently used first
+  std::unordered_map<TileKey, decltype(entries)::iterator, TileKeyHash> lookup;
+};
+
+// Counters shown by /stats
+struct ServerStats {
+  long long requests = 0;
+  long long rendered = 0;
+  long long coalesced = 0;
+  double renderSeconds = 0;
+};
+
+// Everything below is protected by serverMutex
+std::mutex serverMutex;
+std::condition_variable tilesReady;
+std::unique_ptr<PngCache> tileCache; // Created once CACHE_SIZE is known
+std::map<std::string, std::shared_ptr<TileRequest>> inFlight;
+std::deque<std::shared_ptr<TileRequest>> pending;
+int rendering = 0;
+ServerStats stats;
+// Center of the last viewport given by a client, in tiles of its level
+bool hasViewport = false;
+int viewportZ = 0;
+double viewportX = 0, viewportY = 0;
+
+std::unique_ptr<RenderPool> renderPool;
+
+long double getTileSpan(int z) { return WORLD_SIZE / std::ldexp(1.0L, z); }
+
+bool getTileAddress(int set, int z, long long x, long long y, TileAddress &address) {
+  if (z < 0 || z > MAX_LEVEL) { return false; }
+  long long tilesPerSide = 1LL << z;
+  if (x < 0 || y < 0 || x >= tilesPerSide || y >= tilesPerSide) { return false; }
+
+  long double span = getTileSpan(z);
+  address.set = set;
+  address.z = z;
+  address.x = x;
+  address.y = y;
+  address.maxIterations = BASE_ITERATIONS + ITERATIONS_PER_LEVEL * z;
+  address.cx = -WORLD_SIZE / 2 + (x + 0.5L) * span;
+  address.cy = -WORLD_SIZE / 2 + (y + 0.5L) * span;
+  address.zoom = TILE_SIZE / span;
+  return true;
+}
+
+std::string getRequestId(const TileAddress &address) {
+  return std::to_string(address.set) + "/" + std::to_string(address.z) + "/" + std::to_string(address.x) + "/" + std::to_string(address.y);
+}
+
+// Fastest precision that can resolve the tile, -1 if none can
+int getTilePrecision(const TileAddress &address) {
+  if (PRECISION >= 0) {
+    return isPrecisionEnough(PRECISION, address.cx, address.cy, address.zoom) ? PRECISION : -1;
+  }
+  for (int precision = 0; precision < PRECISION_COUNT; precision++) {
+    if (isPrecisionEnough(precision, address.cx, address.cy, address.zoom)) { return precision; }
+  }
+  return -1;
+}
+
+std::string encodePng(const Color *pixels) {
+  std::string png;
+  encodeImage(png, IMAGE_PNG, (const unsigned char *) pixels, TILE_SIZE, TILE_SIZE, 4, TILE_SIZE * sizeof(Color), PNG_OPTIONS);
+  return png;
+}
+
+// Distance of a pending tile to the viewport, in tiles of the viewport level (lower is served first)
+double getPriority(const TileRequest &request) {
+  if (!hasViewport) { return 0; }
+  long double viewportSpan = getTileSpan(viewportZ);
+  long double dx = (request.address.cx + WORLD_SIZE / 2) / viewportSpan - viewportX;
+  long double dy = (request.address.cy + WORLD_SIZE / 2) / viewportSpan - viewportY;
+  return std::sqrt((double) (dx * dx + dy * dy)) + LEVEL_PENALTY * std::abs(request.address.z - viewportZ);
+}
+
+void dispatchTiles();
+
+// Called from the thread that computed the tile
+void onTileRendered(std::shared_ptr<TileRequest> request, const RenderTile &renderTile, const RenderStats &renderStats) {
+  // Encoding is as slow as computing the shallow tiles, keep it out of the lock (and only do it once, the cache keeps the PNG)
+  auto png = std::make_shared<const std::string>(encodePng(renderTile.pixels));
+  delete[] renderTile.pixels;
+
+  std::lock_guard<std::mutex> lock(serverMutex);
+  tileCache->put(request->address.getKey(), png);
+  inFlight.erase(getRequestId(request->address));
+  stats.rendered++;
+  stats.renderSeconds += renderStats.seconds;
+
+  // Every request waiting for this tile gets the same image
+  request->png = std::move(png);
+  request->done = true;
+  tilesReady.notify_all();
+
+  rendering--;
+  dispatchTiles();
+}
+
+// Hand the pending tiles closest to the viewport to the threads that are free (with serverMutex locked), in arrival order without viewport
+// The pool computes tiles in the order they are given, so only as many tiles as threads are given to it
+void dispatchTiles() {
+  while (rendering < THREADS && !pending.empty()) {
+    auto best = pending.begin();
+    double bestPriority = getPriority(**best);
+    for (auto it = pending.begin() + 1; it != pending.end(); it++) {
+      double priority = getPriority(**it);
+      if (priority < bestPriority) {
+        best = it;
+        bestPriority = priority;
+      }
+    }
+    std::shared_ptr<TileRequest> request = *best;
+    pending.erase(best);
+
+    const TileAddress &address = request->address;
+    RenderView view;
+    view.set = address.set;
+    view.precision = getTilePrecision(address);
+    view.lanes = getPreferredLanes(view.set, view.precision);
+    view.cx = address.cx;
+    view.cy = address.cy;
+    view.zoom = address.zoom;
+    view.width = TILE_SIZE;
+    view.height = TILE_SIZE;
+    view.maxIterations = address.maxIterations;
+
+    RenderTile renderTile;
+    renderTile.index = address.z;
+    renderTile.width = TILE_SIZE;
+    renderTile.height = TILE_SIZE;
+    renderTile.pixels = new Color[TILE_SIZE * TILE_SIZE];
+    rendering++;
+    renderPool->submit(view, renderTile, [request](const RenderView &, const RenderTile &renderTile, const RenderStats &renderStats) {
+      onTileRendered(request, renderTile, renderStats);
+    });
+  }
+}
+
+// PNG of a tile, from the cache, from a request already computing it, or computed now
+std::shared_ptr<const std::string> getTilePng(const TileAddress &address) {
+  std::unique_lock<std::mutex> lock(serverMutex);
+  stats.requests++;
+
+  std::shared_ptr<const std::string> cached = tileCache->find(address.getKey());
+  if (cached != nullptr) { return cached; }
+
+  std::string id = getRequestId(address);
+  std::shared_ptr<TileRequest> request;
+  auto it = inFlight.find(id);
+  if (it != inFlight.end()) {
+    request = it->second;
+    stats.coalesced++;
+  } else {
+    request = std::make_shared<TileRequest>();
+    request->address = address;
+    inFlight[id] = request;
+    pending.push_back(request);
+    dispatchTiles();
+  }
+
+  tilesReady.wait(lock, [&request]() { return request->done; });
+  return request->png;
+}
+
+void sendResponse(int client, const std::string &status, const std::string &contentType, const std::string &body) {
+  std::stringstream header;
+  header << "HTTP/1.1 " << status << "\r\n";
+  header << "Content-Type: " << contentType << "\r\n";
+  header << "Content-Length: " << body.size() << "\r\n";
+  header << "Access-Control-Allow-Origin: *\r\n";
+  header << "Connection: close\r\n\r\n";
+  std::string response = header.str() + body;
+
+  size_t sent = 0;
+  while (sent < response.size()) {
+    ssize_t written = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+    if (written <= 0) { return; }
+    sent += written;
+  }
+}
+
+std::vector<std::string> splitPath(const std::string &path) {
+  std::vector<std::string> parts;
+  std::stringstream stream(path.substr(0, path.find('?')));
+  std::string part;
+  while (std::getline(stream, part, '/')) {
+    if (!part.empty()) { parts.push_back(part); }
+  }
+  return parts;
+}
+
+bool parseInteger(const std::string &text, long long &value) {
+  char *end;
+  value = strtoll(text.c_str(), &end, 10);
+  return !text.empty() && *end == '\0';
+}
+
+// GET /z/x/y.png or /set/z/x/y.png : a tile
+// GET /viewport/z/x/y : tiles closest to this point (in tiles of level z, can be fractional) are computed first
+// GET /stats : counters of the server
+void handleRequest(const std::string &path, int client) {
+  std::vector<std::string> parts = splitPath(path);
+
+  if (parts.size() == 1 && parts[0] == "stats") {
+    std::stringstream body;
+    std::lock_guard<std::mutex> lock(serverMutex);
+    body << "requests " << stats.requests << "\n";
+    body << "rendered " << stats.rendered << "\n";
+    body << "coalesced " << stats.coalesced << "\n";
+    body << "cache hits " << tileCache->hits << "\n";
+    body << "cache misses " << tileCache->misses << "\n";
+    body << "pending " << pending.size() << "\n";
+    body << "rendering " << rendering << "\n";
+    body << "render seconds " << stats.renderSeconds << "\n";
+    sendResponse(client, "200 OK", "text/plain", body.str());
+    return;
+  }
+
+  if (parts.size() == 4 && parts[0] == "viewport") {
+    long long z;
+    char *endX, *endY;
+    double x = strtod(parts[2].c_str(), &endX);
+    double y = strtod(parts[3].c_str(), &endY);
+    if (!parseInteger(parts[1], z) || z < 0 || z > MAX_LEVEL || *endX != '\0' || *endY != '\0') {
+      sendResponse(client, "400 Bad Request", "text/plain", "Expected /viewport/z/x/y\n");
+      return;
+    }
+    std::lock_guard<std::mutex> lock(serverMutex);
+    hasViewport = true;
+    viewportZ = z;
+    viewportX = x;
+    viewportY = y;
+    sendResponse(client, "204 No Content", "text/plain", "");
+    return;
+  }
+
+  // Tiles, with the default set or the one given before the level
+  int set = SET;
+  if (parts.size() == 4) {
+    set = getSetFromName(parts[0]);
+    parts.erase(parts.begin());
+  }
+  std::string last = parts.empty() ? "" : parts.back();
+  if (set < 0 || parts.size() != 3 || last.size() < 5 || last.compare(last.size() - 4, 4, ".png") != 0) {
+    sendResponse(client, "404 Not Found", "text/plain", "Expected /z/x/y.png or /set/z/x/y.png\n");
+    return;
+  }
+
+  long long z, x, y;
+  TileAddress address;
+  if (!parseInteger(parts[0], z) || !parseInteger(parts[1], x) || !parseInteger(last.substr(0, last.size() - 4), y) ||
+      !getTileAddress(set, z, x, y, address)) {
+    sendResponse(client, "404 Not Found", "text/plain", "No such tile\n");
+    return;
+  }
+  if (getTilePrecision(address) < 0) {
+    sendResponse(client, "404 Not Found", "text/plain", "Not enough precision for this level\n");
+    return;
+  }
+
+  sendResponse(client, "200 OK", "image/png", *getTilePng(address));
+}
+
+// One thread per connection, it waits for its tile without holding a render thread
+void handleClient(int client) {
+  // Don't let an idle client hold the thread forever
+  timeval timeout = {10, 0};
+  setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  std::string request;
+  char buffer[4096];
+  while (request.find("\r\n\r\n") == std::string::npos && request.size() < 16384) {
+    ssize_t received = recv(client, buffer, sizeof(buffer), 0);
+    if (received <= 0) { break; }
+    request.append(buffer, received);
+  }
+
+  std::string method, path;
+  std::stringstream requestLine(request.substr(0, request.find("\r\n")));
+  if (!(requestLine >> method >> path)) {
+    sendResponse(client, "400 Bad Request", "text/plain", "Bad request\n");
+  } else if (method != "GET") {
+    sendResponse(client, "405 Method Not Allowed", "text/plain", "Only GET is supported\n");
+  } else {
+    handleRequest(path, client);
+  }
+  close(client);
+}
+
+
+// Main function
+int main(int argc, char *argv[]) {
+  // Replace constants by the ones given in the flags (if present)
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--host") {
+      HOST = argv[++i];
+    } else if (arg == "--port") {
+      PORT = std::stoi(argv[++i]);
+    } else if (arg == "--set") {
+      SET = getSetFromName(argv[++i]);
+      if (SET < 0) {
+        std::cerr << "Unknown set " << argv[i] << std::endl;
+        return 1;
+      }
+    } else if (arg == "--tile-size") {
+      TILE_SIZE = std::stoi(argv[++i]);
+    } else if (arg == "--it") {
+      BASE_ITERATIONS = std::stoi(argv[++i]);
+    } else if (arg == "--it-per-level") {
+      ITERATIONS_PER_LEVEL = std::stoi(argv[++i]);
+    } else if (arg == "--precision") {
+      std::string name = argv[++i];
+      PRECISION = name == "auto" ? -1 : getPrecisionFromName(name);
+      if (name != "auto" && PRECISION < 0) {
+        std::cerr << "Unknown precision " << name << std::endl;
+        return 1;
+      }
+    } else if (arg == "--threads") {
+      THREADS = std::max(1, std::stoi(argv[++i]));
+    } else if (arg == "--png-level") {
+      PNG_OPTIONS.pngLevel = std::stoi(argv[++i]);
+    } else if (arg == "--png-filter") {
+      PNG_OPTIONS.pngFilter = std::stoi(argv[++i]);
+    } else if (arg == "--cache") {
+      CACHE_SIZE = std::max(1, std::stoi(argv[++i]));
+    } else {
+      std::cerr << "Unknown flag " << arg << std::endl;
+      return 1;
+    }
+  }
+  if (TILE_SIZE < 1 || TILE_SIZE > 4096) {
+    std::cerr << "The tile size must be between 1 and 4096" << std::endl;
+    return 1;
+  }
+
+  // Clients closing the connection early must not kill the server
+  signal(SIGPIPE, SIG_IGN);
+
+  int server = socket(AF_INET, SOCK_STREAM, 0);
+  int reuse = 1;
+  setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(PORT);
+  if (server < 0 || inet_pton(AF_INET, HOST.c_str(), &address.sin_addr) != 1 || bind(server, (sockaddr *) &address, sizeof(address)) < 0 ||
+      listen(server, 128) < 0) {
+    std::cerr << "Could not listen on " << HOST << ":" << PORT << " (" << strerror(errno) << ")" << std::endl;
+    return 1;
+  }
+
+  tileCache = std::make_unique<PngCache>(CACHE_SIZE);
+  renderPool = std::make_unique<RenderPool>(THREADS);
+  std::cout << "Serving " << getSetName(SET) << " tiles on http://" << HOST << ":" << PORT << "/z/x/y.png with " << THREADS << " threads" << std::endl;
+
+  while (true) {
+    int client = accept(server, nullptr, nullptr);
+    if (client < 0) { continue; }
+    std::thread(handleClient, client).detach();
+  }
+}
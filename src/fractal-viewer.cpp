@@ -1,9 +1,25 @@
-#include <unordered_set>
 #include <thread>
 #include <iostream>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <unordered_set>
 
 // Own implementations
 #include "sets_definition.hpp"
+#include "tile_scheduler.hpp"
+#include "trace.hpp"
+#include "tile_cache.hpp"
+#include "tile_buffer_pool.hpp"
+#include "completion_queue.hpp"
+#include "renderer.hpp"
+#include "histogram.hpp"
+#include "julia_preview.hpp"
 
 
 // Constants (changeable with flags)
@@ -21,20 +37,56 @@ const int TILES_Y = 9;
 // Debug tool to visualize the individual tiles (can toggle with LSHIFT)
 bool SHOW_TILES = false;
 
-// Detaches the threads, makes the app smoother but can cause a lot of visual glitches at high iterations and big zoom
+// Renders the tiles in the background, makes the app smoother but can cause a lot of visual glitches at high iterations and big zoom
 // If set to false, there are no visual glitches but the app is a lot slower and has freezes at high iterations
 bool DETACHED_MODE = true;
 const int MAX_THREADS = std::thread::hardware_concurrency();
 // Should be set to true, avoids unnecessary re-renders of the same tile, makes the app faster but transitions can be worse
 bool AVOID_DUPLICATES = true;
+// Computes the tiles under the cursor (or the centre of the screen) first, following the camera movement, instead of a fixed spiral / sweep
+bool PRIORITIZE_FOCUS = true;
+// Views computed ahead of the camera (into the tile cache) while a movement key is held, by the threads left idle (0 to disable)
+int PREFETCH_VIEWS = 2;
+// When zooming in, the tiles start from the iterations of the last complete view : its uniform areas are only checked on a coarse grid instead of computed
+// Opt-in, a few pixels can be off by an iteration near thin filaments
+bool REPROJECT = false;
+// How the pixels are colored, iterations, distance or histogram (can change with E)
+int COLORING = COLORING_ITERATIONS;
+// Points inside the set stop once their orbit fell in a cycle : off, detect or period (colored by the cycle), can change with I
+int INTERIOR = INTERIOR_OFF;
+// Julia c and Phoenix p (--julia-c and --phoenix-p, "re,im"), Lyapunov sequence and warm-up
+SetParameters PARAMETERS;
+// Grid of Julia previews for the c values around the cursor on the Mandelbrot sets, a click opens the one under the cursor (can toggle with J)
+bool JULIA_PREVIEW = false;
+// Extra samples for the pixels on the edges of the color bands, averaged with them (0 : no anti-aliasing)
+int AA_SAMPLES = 0;
 // Should reduce black frames, but slows down the app (can introduce some stutters)
 bool USE_OLD_TEXTURES = true;
+// Where to write the timeline of the tiles when the app closes (or when pressing T), nothing if empty
+std::string TRACE_PATH = "";
+// Shows the performance overlay (can toggle with H)
+bool SHOW_PERFORMANCE = false;
+// How many computed tiles are kept to be shown again without computing them (4 screens)
+const int TILE_CACHE_SIZE = 4 * 16 * 9;
 
 // What change in zoom should trigger a re-render of the view (0.5 -> 50%)
 const float zoomAcceptedChange = 0.25f;
 // What change in position should trigger a re-render of the view
 const float cameraAcceptedChange = 0.25f * 1000.0f;
 
+// Histogram coloring : the levels are spread again once this many times more tiles of the view were counted (or the last one)
+const float HISTOGRAM_GROWTH = 1.25f;
+// Smallest change of a level worth uploading the shown tiles again (about one step of the gradient)
+const float HISTOGRAM_MIN_CHANGE = 1.0f / 256;
+
+// Julia previews : how many on each side of the one under the cursor (2 : 5 x 5), their size, and the screen pixels between their c
+const int PREVIEW_RADIUS = 2;
+const int PREVIEW_SIZE = 96;
+const float PREVIEW_SPACING = 12;
+// Iterations of the previews (at most the ones of the view), and how many are kept
+const float PREVIEW_ITERATIONS = 300;
+const int PREVIEW_CACHE_SIZE = 1024;
+
 // Initial position and settings of the camera
 long double cameraX = 0;
 long double cameraY = 0;
@@ -47,225 +99,419 @@ float TILE_WIDTH, TILE_HEIGHT;
 float HALF_SCREEN_WIDTH, HALF_SCREEN_HEIGHT;
 
 // Multi-threading
-std::atomic<int> runningThreads(0);
-struct PendingTile {
-  int index;
-  long double cx, cy, cz;
-  int generation;
-  float maxIterations;
-};
-std::deque<PendingTile> pendingTiles;
-std::unordered_set<int> tilesScheduled; // To avoid duplicates in queue
+TileScheduler scheduler(TILES_X, TILES_Y);
+// Tiles of the next views, only computed when the other queue is empty
+TileScheduler prefetchScheduler(TILES_X, TILES_Y);
+
+// Performance counters, for the performance overlay
+std::atomic<long long> iterationsDone(0);
+std::atomic<int> tilesWasted(0); // Computed but never shown, because a newer generation got there first
+int tilesPrefetched = 0;
+std::atomic<long long> pixelsRendered(0), pixelsSkipped(0); // Skipped : reprojected or in an empty disc
+// Compute time of the last tiles (in seconds)
+const int TILE_TIMES_SIZE = 256;
+std::mutex tileTimesMutex;
+std::vector<float> tileTimes;
+int tileTimesWritten = 0;
+
+void recordTileTime(float seconds) {
+  std::lock_guard<std::mutex> lock(tileTimesMutex);
+  if ((int) tileTimes.size() < TILE_TIMES_SIZE) {
+    tileTimes.push_back(seconds);
+  } else {
+    tileTimes[tileTimesWritten % TILE_TIMES_SIZE] = seconds;
+  }
+  tileTimesWritten++;
+}
 
 // CODE //
 
-// Tile structure
+// Tile structure, only used by the main thread (the render threads hand their pixels through the completion queue)
 struct Tile {
-  // Lock used to modify the tile in different threads
-  std::mutex texMutex;
-
   // Textures
   RenderTexture2D texture, oldTexture, veryOldTexture;
   int tileX, tileY;
 
-  // Coordinates of the top left corner of the tile, and zoom from when it was scheduled
+  // Coordinates of the top left corner of the tile, and zoom from when it was computed
   long double x, y, z;
-  // Coordinates of the camera when the tile was computed
-  long double cx, cy, cz;
 
   // Old positions to draw the old texture
   long double oldX, oldY, oldZ;
   long double veryOldX, veryOldY, veryOldZ;
   
-  // Actual pixel information of the tile
-  Color *pixels;
-  bool hasComputed = false;
+  // Newest generation started, older pixels arriving later are dropped
   int generation = 0;
+  // Generation of the samples its texture can be recolored from (histogram coloring), -1 if it came from the tile cache
+  int samplesGeneration = -1;
 };
 
 // List of all the tiles
 std::vector<Tile> tiles(TILES_X *TILES_Y);
 
-// Compute a tile in the background
-void computeTileThread(int tileIndex, long double cx, long double cy, long double cz, int generation, float maxIterations) {
-  // Add one to the thread counter
-  runningThreads.fetch_add(1, std::memory_order_relaxed);
+// Pixels of the tiles being computed, waiting to be uploaded and in the tile cache (created once the tile size is known)
+std::unique_ptr<TileBufferPool> bufferPool;
+// Tiles that found no free buffer, started again on the next frame
+std::vector<PendingTile> deferredTiles;
 
-  // Get the tile
-  Tile &tile = tiles[tileIndex];
+// Pixels computed for a tile, and with what
+struct CompletedTile {
+  int index;
+  int generation;
+  Color *pixels;
+  long double cx, cy, cz;
+  int set;
+  float maxIterations;
+  int coloring;
+  int interior;
+  SetParameters parameters;
+  bool prefetch = false; // Only goes to the tile cache
+  bool sampled = false;  // Its samples were written in the ones of its view (computed, not from the cache)
+};
 
-  // Update generation count
-  {
-    std::lock_guard<std::mutex> lock(tile.texMutex);
-    if (tile.generation <= generation) {
-      tile.generation = generation;
+// Samples of the tiles of a view, once every tile is done they seed the tiles of the next views
+struct ViewSamples {
+  int generation;
+  SampleFrame frame;
+  int tilesDone = 0; // Only used by the main loop
+  // With histogram coloring, filled by the render threads as the tiles are done
+  std::unique_ptr<HistogramAccumulator> histogram;
+  int histogramTiles = 0; // Tiles done when the levels were last spread, only used by the main loop
+};
+std::shared_ptr<ViewSamples> newestSamples;   // Newest generation started
+std::shared_ptr<ViewSamples> completeSamples; // Newest generation with every tile done, not written anymore
+// Samples of the past views, a full screen each, reused once nothing else points to them (only the main loop hands them out)
+std::vector<std::shared_ptr<ViewSamples>> samplesPool;
+
+std::shared_ptr<ViewSamples> getFreeSamples() {
+  for (const auto &samples : samplesPool) {
+    if (samples.use_count() == 1) {
+      // The render threads wrote the samples before dropping their reference
+      std::atomic_thread_fence(std::memory_order_acquire);
+      return samples;
     }
   }
+  samplesPool.push_back(std::make_shared<ViewSamples>());
+  return samplesPool.back();
+}
+// Palette of the newest histogram, the tiles being started are colored with it (kept from the view before until a quarter of the view is done)
+std::shared_ptr<const HistogramPalette> histogramPalette;
+
+// Finished tiles, pushed by the render threads and taken by the main loop (created with the buffer pool, as big as it)
+std::unique_ptr<CompletionQueue<CompletedTile>> completedTiles;
+
+// Hand computed pixels to the main loop, which uploads them unless a newer generation got there first
+void saveTilePixels(const CompletedTile &completed) {
+  bufferPool->markReady(completed.pixels);
+  // Every buffer fits in the queue, so it can only be full for a moment
+  while (!completedTiles->push(completed)) {
+    std::this_thread::yield();
+  }
+}
 
-  // Compute the pixels
-  int jTileWidth;
-  long double x, y;
-  Color *pixels = new Color[TILE_WIDTH * TILE_HEIGHT];
-  for (int j = 0; j < TILE_HEIGHT; j++) {
-    jTileWidth = j * TILE_WIDTH;
-    for (int i = 0; i < TILE_WIDTH; i++) {
-      x = (i + tile.tileX * TILE_WIDTH - HALF_SCREEN_WIDTH) / cz + cx;
-      y = (j + tile.tileY * TILE_HEIGHT - HALF_SCREEN_HEIGHT) / cz + cy;
-
-      switch (SET) {
-        case 0: pixels[jTileWidth + i] = getColorFromPoint_Mandelbrot(x, y, maxIterations);  break;
-        case 1: pixels[jTileWidth + i] = getColorFromPoint_Julia(x, y, maxIterations);  break;
-        case 2: pixels[jTileWidth + i] = getColorFromPoint_BurningShip(x, y, maxIterations);  break;
-        case 3: pixels[jTileWidth + i] = getColorFromPoint_Tricorn(x, y, maxIterations);  break;
-        case 4: pixels[jTileWidth + i] = getColorFromPoint_Phoenix(x, y, maxIterations);  break;
-        case 5: pixels[jTileWidth + i] = getColorFromPoint_Lyapunov(x, y, maxIterations);  break;
-        case 6: pixels[jTileWidth + i] = getColorFromPoint_Mandelbrot_LightEffect(x, y, maxIterations);  break;
-        
-        default: break;
-      }
-    }
+// Threads computing the tiles (after the tiles, so it is stopped before them)
+RenderPool renderPool(MAX_THREADS);
+
+// Start computing a tile in the background, false if no buffer was free (the tile is deferred, prefetched ones are dropped)
+bool startTile(const PendingTile &pendingTile, bool prefetch = false) {
+  Color *pixels = bufferPool->acquire();
+  if (pixels == nullptr) {
+    if (!prefetch) { deferredTiles.push_back(pendingTile); }
+    return false;
   }
+  Tile &tile = tiles[pendingTile.index];
 
-  // Lock tile to save computed pixels
-  {
-    std::lock_guard<std::mutex> lock(tile.texMutex);
-    if (tile.generation <= generation) {
-      tile.generation = generation;
-      tile.pixels = pixels;
-      tile.hasComputed = true;
-      tile.cx = cx;
-      tile.cy = cy;
-      tile.cz = cz;
+  // Update generation count, so the older requests of this tile still queued are skipped
+  if (!prefetch && tile.generation <= pendingTile.generation) {
+    tile.generation = pendingTile.generation;
+  }
+
+  RenderView view;
+  view.set = SET;
+  view.parameters = PARAMETERS;
+  view.cx = pendingTile.cx;
+  view.cy = pendingTile.cy;
+  view.zoom = pendingTile.cz;
+  view.width = SCREEN_WIDTH;
+  view.height = SCREEN_HEIGHT;
+  view.maxIterations = pendingTile.maxIterations;
+  view.aaSamples = AA_SAMPLES;
+  view.coloring = COLORING;
+  view.interior = INTERIOR;
+  view.histogram = histogramPalette;
+
+  RenderTile renderTile;
+  renderTile.index = pendingTile.index;
+  renderTile.generation = pendingTile.generation;
+  renderTile.x = tile.tileX * TILE_WIDTH;
+  renderTile.y = tile.tileY * TILE_HEIGHT;
+  renderTile.width = TILE_WIDTH;
+  renderTile.height = TILE_HEIGHT;
+  renderTile.pixels = pixels;
+
+  // Write the samples in the ones of the newest view (also counted in its histogram), and start from the last complete view
+  std::shared_ptr<ViewSamples> samples, previous;
+  bool histogram = COLORING == COLORING_HISTOGRAM;
+  if (REPROJECT || histogram) {
+    if (!prefetch && (newestSamples == nullptr || newestSamples->generation < pendingTile.generation)) {
+      newestSamples = getFreeSamples();
+      newestSamples->generation = pendingTile.generation;
+      newestSamples->frame.view = view;
+      // Not cleared : computed tiles write every sample of their rectangle, the others are marked missing when they are back
+      newestSamples->frame.samples.resize(SCREEN_WIDTH * SCREEN_HEIGHT);
+      newestSamples->tilesDone = 0;
+      newestSamples->histogram = histogram ? std::make_unique<HistogramAccumulator>(view.maxIterations, renderPool.getThreadCount()) : nullptr;
+      newestSamples->histogramTiles = 0;
+    }
+    if (!prefetch && newestSamples->generation == pendingTile.generation) {
+      samples = newestSamples;
+      renderTile.samples = &samples->frame.samples[renderTile.y * SCREEN_WIDTH + renderTile.x];
+      renderTile.sampleStride = SCREEN_WIDTH;
     }
   }
+  if (REPROJECT) {
+    previous = completeSamples;
+    renderTile.previous = previous != nullptr ? &previous->frame : nullptr;
+  }
 
-  // Remove one from the thread counter
-  runningThreads.fetch_sub(1, std::memory_order_relaxed);
+  renderPool.submit(view, renderTile, [prefetch, samples, previous](const RenderView &view, const RenderTile &tile, const RenderStats &stats) {
+    if (samples != nullptr && samples->histogram != nullptr) {
+      samples->histogram->add(stats.worker, tile.samples, tile.width, tile.height, tile.sampleStride);
+    }
+    iterationsDone.fetch_add(stats.iterations, std::memory_order_relaxed);
+    pixelsRendered.fetch_add(tile.width * tile.height, std::memory_order_relaxed);
+    pixelsSkipped.fetch_add(stats.pixelsReprojected + stats.pixelsSkipped, std::memory_order_relaxed);
+    recordTileTime(stats.seconds);
+    saveTilePixels({tile.index, tile.generation, tile.pixels, view.cx, view.cy, view.zoom, view.set, view.maxIterations, view.coloring, view.interior, view.parameters, prefetch,
+                    samples != nullptr});
+  });
+  return true;
 }
 
-// Do a spiral
-std::vector<int> getSpiralIndicesOutward(int TILES_X, int TILES_Y) {
-  std::vector<int> result;
-  std::vector<std::vector<bool>> visited(TILES_Y, std::vector<bool>(TILES_X, false));
-
-  // Starting position (center)
-  int startX = TILES_X / 2;
-  int startY = TILES_Y / 2;
+// Spread the histogram levels again from the tiles of the newest view counted so far, and recolor the tiles of that view already shown
+void updateHistogram(ViewSamples &view) {
+  int tileCount = TILES_X * TILES_Y;
+  bool last = view.tilesDone == tileCount;
+  if (view.tilesDone == view.histogramTiles || (!last && view.tilesDone < view.histogramTiles * HISTOGRAM_GROWTH + 1)) { return; }
+  // The first tiles (the ones under the cursor) don't tell much about the whole view
+  if (!last && histogramPalette != nullptr && view.tilesDone < tileCount / 4) { return; }
+  view.histogramTiles = view.tilesDone;
+
+  auto palette = std::make_shared<const HistogramPalette>(view.histogram->reduce(MAX_THREADS));
+  if (histogramPalette != nullptr && histogramPalette->levels.size() == palette->levels.size()) {
+    float change = 0;
+    for (size_t i = 0; i < palette->levels.size(); i++) { change = std::max(change, std::abs(palette->levels[i] - histogramPalette->levels[i])); }
+    if (change < HISTOGRAM_MIN_CHANGE) { return; }
+  }
+  histogramPalette = palette;
+
+  RenderView recolored = view.frame.view;
+  recolored.histogram = palette;
+  static std::vector<Color> pixels;
+  pixels.resize(TILE_WIDTH * TILE_HEIGHT);
+  for (Tile &tile : tiles) {
+    if (tile.samplesGeneration != view.generation) { continue; }
+    RenderTile renderTile;
+    renderTile.index = tile.tileY * TILES_X + tile.tileX;
+    renderTile.generation = view.generation;
+    renderTile.x = tile.tileX * TILE_WIDTH;
+    renderTile.y = tile.tileY * TILE_HEIGHT;
+    renderTile.width = TILE_WIDTH;
+    renderTile.height = TILE_HEIGHT;
+    renderTile.pixels = pixels.data();
+    renderTile.samples = &view.frame.samples[renderTile.y * SCREEN_WIDTH + renderTile.x];
+    renderTile.sampleStride = SCREEN_WIDTH;
+    recolorTile(recolored, renderTile);
+    UpdateTexture(tile.texture.texture, pixels.data());
+  }
+}
 
-  // Direction vectors: right, down, left, up
-  int dx[] = {1, 0, -1, 0};
-  int dy[] = {0, 1, 0, -1};
-  int direction = 0;
+// Keys moving the camera, held during a frame
+struct CameraKeys {
+  bool up = false, down = false, left = false, right = false, zoomIn = false, zoomOut = false;
 
-  int x = startX, y = startY;
-  int steps = 1;
+  bool any() const { return up || down || left || right || zoomIn || zoomOut; }
+  bool operator==(const CameraKeys &other) const {
+    return up == other.up && down == other.down && left == other.left && right == other.right && zoomIn == other.zoomIn && zoomOut == other.zoomOut;
+  }
+  bool operator!=(const CameraKeys &other) const { return !(*this == other); }
+};
 
-  // Add center point
-  result.push_back(x + y * TILES_X);
-  visited[y][x] = true;
+// Move the camera by one frame, the movement doesn't depend on the frame time so it can be predicted exactly
+void moveCamera(long double &x, long double &y, long double &z, const CameraKeys &keys, float movement, float zoomStep) {
+  if (keys.up) { y -= movement / z; }
+  if (keys.down) { y += movement / z; }
+  if (keys.left) { x -= movement / z; }
+  if (keys.right) { x += movement / z; }
+  if (keys.zoomIn) { z *= (1 + zoomStep); }
+  if (keys.zoomOut) { z *= (1 - zoomStep); }
+}
 
-  while (result.size() < TILES_X * TILES_Y) {
-    for (int i = 0; i < 2; i++) { // Move in current direction twice per spiral layer
-      for (int step = 0; step < steps; step++) {
-        x += dx[direction];
-        y += dy[direction];
+// If the camera moved too far from where the view was computed, it is computed again
+bool viewMovedTooMuch(long double x, long double y, long double z, long double renderedX, long double renderedY, long double renderedZ) {
+  float acceptedChange = cameraAcceptedChange / z;
+  return abs(x - renderedX) >= acceptedChange || abs(y - renderedY) >= acceptedChange || abs(1 - (z / renderedZ)) >= zoomAcceptedChange;
+}
 
-        if (x >= 0 && x < TILES_X && y >= 0 && y < TILES_Y && !visited[y][x]) {
-          result.push_back(x + y * TILES_X);
-          visited[y][x] = true;
-        }
-      }
-      direction = (direction + 1) % 4; // Turn 90 degrees
-    }
-    steps++; // Increase step count for next spiral layer
+// Queue the views the main loop will compute next if the same keys stay held
+// The frames are replayed from the current camera, so the predicted views have exactly the values the main loop will get, and are found in the tile cache
+void prefetchViews(const CameraKeys &keys, long double x, long double y, long double z, long double renderedX, long double renderedY, long double renderedZ,
+                   float maxIterations, float movement, float zoomStep) {
+  prefetchScheduler.clear();
+  if (!keys.any() || !DETACHED_MODE) { return; }
+
+  for (int view = 1; view <= PREFETCH_VIEWS; view++) {
+    // Give up on movements too slow to need it
+    int frames = 0;
+    do {
+      moveCamera(x, y, z, keys, movement, zoomStep);
+    } while (!viewMovedTooMuch(x, y, z, renderedX, renderedY, renderedZ) && ++frames < 10 * TARGET_FPS);
+    if (frames == 10 * TARGET_FPS) { return; }
+
+    // The closest view goes first
+    prefetchScheduler.scheduleView(x, y, z, -view, maxIterations, renderedX - x, renderedY - y);
+    renderedX = x;
+    renderedY = y;
+    renderedZ = z;
   }
-
-  return result;
 }
 
 // Launch all tile updates in parallel
-std::vector<int> spiralIndicesOutward = getSpiralIndicesOutward(TILES_X, TILES_Y);
 void updateTilesParallel(long double cx, long double cy, long double cz, int generation, float maxIterations, long double diffX, long double diffY) {
   int tileCount = tiles.size();
 
   if (DETACHED_MODE) {
-    // Adds the tile to the queue, with all needed information to compute the pixels
-    auto scheduleTile = [cx, cy, cz, generation, maxIterations] (int i) {
-      PendingTile pendingTile = {i, cx, cy, cz, generation, maxIterations};
-
-      // Remove tile from pending list if it was already scheduled (optional, but makes the app faster)
-      if (AVOID_DUPLICATES && tilesScheduled.find(i) != tilesScheduled.end()) {
-        for (auto it = pendingTiles.begin(); it != pendingTiles.end(); ++it) {
-          if (it->index == i) {
-            pendingTiles.erase(it);
-            break;
-          }
-        }
+    // Queue the tiles, the main loop starts them as threads become available
+    scheduler.scheduleView(cx, cy, cz, generation, maxIterations, diffX, diffY);
+  }
+  else {
+    // Compute all tiles at the same time, the ones without a free buffer wait for the next frame
+    for (int i = 0; i < tileCount; ++i) {
+      PendingTile pending = {i, cx, cy, cz, generation, maxIterations};
+      if (bufferPool->getCount(TileBufferPool::FREE) > 0) {
+        startTile(pending);
+      } else {
+        deferredTiles.push_back(pending);
       }
+    }
+    renderPool.wait();
+  }
+}
 
-      // Add tile to the queue
-      pendingTiles.push_back(pendingTile);
-      tilesScheduled.insert(i);
-    };
+// Julia previews
+// A cell of the grid of previews, its texture keeps the last preview uploaded to it
+struct PreviewCell {
+  int i, j; // From the cell under the cursor
+  RenderTexture2D texture;
+  long double re = 0, im = 0;
+  float maxIterations = 0;
+  bool shown = false;    // Something was uploaded
+  bool upToDate = false; // It is the preview of the c the cell has now
+};
 
-    // Do a spiral pattern if simply zooming in or out
-    if (diffX == 0 && diffY == 0) {
-      for (const int index : spiralIndicesOutward) {
-        scheduleTile(index);
-      }
-      return;
-    }
+bool hasJuliaPreviews(int set) {
+  return set == SET_MANDELBROT || set == SET_MANDELBROT_LIGHT_EFFECT;
+}
 
-    // Change the order of the tiles based on movement direction
-    if (diffX >= 0) {
-      if (diffY >= 0) {
-        // Top left
-        for (int i = 0; i < TILES_X; ++i) {
-          for (int j = 0; j < TILES_Y; ++j) {
-            scheduleTile(j * TILES_X + i);
-          }
-        }
-      }
-      else {
-        // Bottom left
-        for (int i = 0; i < TILES_X; ++i) {
-          for (int j = TILES_Y - 1; j >= 0; --j) {
-            scheduleTile(j * TILES_X + i);
-          }
-        }
-      }
-    }
-    else {
-      if (diffY >= 0) {
-        // Top right
-        for (int i = TILES_X - 1; i >= 0; --i) {
-          for (int j = 0; j < TILES_Y; ++j) {
-            scheduleTile(j * TILES_X + i);
-          }
-        }
-      }
-      else {
-        // Bottom right
-        for (int i = TILES_X - 1; i >= 0; --i) {
-          for (int j = TILES_Y - 1; j >= 0; --j) {
-            scheduleTile(j * TILES_X + i);
-          }
-        }
-      }
+// c of the preview (i, j) of the grid, the cursor is snapped to a grid of PREVIEW_SPACING pixels so a small movement keeps the same previews
+void getPreviewParameter(Vector2 cursor, int i, int j, long double &re, long double &im) {
+  long double step = PREVIEW_SPACING / zoom;
+  re = (std::round((cameraX + (cursor.x - HALF_SCREEN_WIDTH) / zoom) / step) + i) * step;
+  im = (std::round((cameraY + (cursor.y - HALF_SCREEN_HEIGHT) / zoom) / step) + j) * step;
+}
+
+// Upload the previews of the cells that changed, asking for the missing ones from the center outwards so the one under the cursor comes first
+void updateJuliaPreviews(std::vector<PreviewCell> &cells, JuliaPreviewCache &cache, Vector2 cursor, float maxIterations) {
+  for (int ring = 0; ring <= PREVIEW_RADIUS; ring++) {
+    for (PreviewCell &cell : cells) {
+      if (std::max(std::abs(cell.i), std::abs(cell.j)) != ring) { continue; }
+      long double re, im;
+      getPreviewParameter(cursor, cell.i, cell.j, re, im);
+      cell.upToDate = cell.shown && cell.re == re && cell.im == im && cell.maxIterations == maxIterations;
+      if (cell.upToDate) { continue; }
+
+      const Color *pixels = cache.get(renderPool, re, im, maxIterations);
+      if (pixels == nullptr) { continue; }
+      UpdateTexture(cell.texture.texture, pixels);
+      cell.re = re;
+      cell.im = im;
+      cell.maxIterations = maxIterations;
+      cell.shown = true;
+      cell.upToDate = true;
     }
   }
-  else {
-    // Compute all threads at the same time
-    std::vector<std::thread> workers;
-    for (int i = 0; i < tileCount; ++i) {
-      workers.emplace_back(computeTileThread, i, cx, cy, cz, generation, maxIterations);
+}
+
+// The grid next to the cursor (on the side with room for it), and the points of the view its c come from
+// Cells still waiting for their preview show the old one darker
+void drawJuliaPreviews(const std::vector<PreviewCell> &cells, Vector2 cursor) {
+  const int side = (2 * PREVIEW_RADIUS + 1) * PREVIEW_SIZE;
+  const int margin = 24;
+  int left = cursor.x + margin + side <= SCREEN_WIDTH ? cursor.x + margin : std::max(0, (int) cursor.x - margin - side);
+  int top = cursor.y + margin + side <= SCREEN_HEIGHT ? cursor.y + margin : std::max(0, (int) cursor.y - margin - side);
+
+  for (const PreviewCell &cell : cells) {
+    long double re, im;
+    getPreviewParameter(cursor, cell.i, cell.j, re, im);
+    bool center = cell.i == 0 && cell.j == 0;
+    DrawRectangle((re - cameraX) * zoom + HALF_SCREEN_WIDTH - 1, (im - cameraY) * zoom + HALF_SCREEN_HEIGHT - 1, 3, 3, center ? WHITE : GRAY);
+
+    int x = left + (cell.i + PREVIEW_RADIUS) * PREVIEW_SIZE;
+    int y = top + (cell.j + PREVIEW_RADIUS) * PREVIEW_SIZE;
+    if (cell.shown) {
+      DrawTexturePro(cell.texture.texture, {0, 0, (float) PREVIEW_SIZE, (float) PREVIEW_SIZE}, {(float) x, (float) y, (float) PREVIEW_SIZE, (float) PREVIEW_SIZE},
+                     {0, 0}, 0, cell.upToDate ? WHITE : DARKGRAY);
+    } else {
+      DrawRectangle(x, y, PREVIEW_SIZE, PREVIEW_SIZE, BLACK);
     }
-    for (auto &t : workers) {
-      t.join(); // waits for all threads
+    if (center) {
+      DrawRectangleLines(x, y, PREVIEW_SIZE, PREVIEW_SIZE, WHITE);
+      DrawText(TextFormat("c = %.12f %+.12fi", (double) re, (double) im), left, std::min(top + side + 4, SCREEN_HEIGHT - 20), 20, WHITE);
     }
   }
 }
 
+// Performance overlay : work done, tile compute times (with a histogram), wasted tiles, tile cache and texture uploads
+void drawPerformanceOverlay(int x, int y, float iterationsPerSecond, const TileCache &tileCache, int bytesUploaded, float bytesUploadedPerFrame) {
+  std::vector<float> times;
+  {
+    std::lock_guard<std::mutex> lock(tileTimesMutex);
+    times = tileTimes;
+  }
+  std::sort(times.begin(), times.end());
+  float p50 = times.empty() ? 0 : times[times.size() / 2] * 1000;
+  float p99 = times.empty() ? 0 : times[(times.size() - 1) * 99 / 100] * 1000;
+
+  int lookups = tileCache.hits + tileCache.misses;
+  float hitRatio = lookups == 0 ? 0 : 100.0f * tileCache.hits / lookups;
+
+  long long rendered = pixelsRendered.load(std::memory_order_relaxed);
+  float skippedRatio = rendered == 0 ? 0 : 100.0f * pixelsSkipped.load(std::memory_order_relaxed) / rendered;
+
+  DrawText(TextFormat("Iterations/s: %.2f M | skipped: %.0f%%", iterationsPerSecond / 1e6f, skippedRatio), x, y, 20, WHITE);
+  DrawText(TextFormat("Tile time: p50 %.1f ms | p99 %.1f ms", p50, p99), x, y + 20, 20, WHITE);
+  DrawText(TextFormat("Wasted tiles: %i | prefetched: %i", tilesWasted.load(std::memory_order_relaxed), tilesPrefetched), x, y + 40, 20, WHITE);
+  DrawText(TextFormat("Cache hits: %.0f%% (%i / %i)", hitRatio, tileCache.hits, lookups), x, y + 60, 20, WHITE);
+  DrawText(TextFormat("Uploaded: %i KB | %.0f KB/frame", bytesUploaded / 1024, bytesUploadedPerFrame / 1024), x, y + 80, 20, WHITE);
+  DrawText(TextFormat("Buffers: %i in use | %i ready | %i cached | %i free", bufferPool->getCount(TileBufferPool::IN_USE),
+                      bufferPool->getCount(TileBufferPool::READY), bufferPool->getCount(TileBufferPool::CACHED),
+                      bufferPool->getCount(TileBufferPool::FREE)), x, y + 100, 20, WHITE);
+
+  // Histogram of the last tile times, each bar twice as long as the previous one (from 0.25 ms)
+  const int BUCKETS = 12;
+  int counts[BUCKETS] = {0};
+  int highest = 1;
+  for (float time : times) {
+    int bucket = time * 1000 < 0.25f ? 0 : std::min(BUCKETS - 1, 1 + (int) std::log2(time * 1000 / 0.25f));
+    highest = std::max(highest, ++counts[bucket]);
+  }
+  for (int i = 0; i < BUCKETS; i++) {
+    int height = 40 * counts[i] / highest;
+    DrawRectangle(x + i * 12, y + 165 - height, 10, height, GREEN);
+  }
+  DrawText("0.25 ms", x, y + 170, 10, WHITE);
+  DrawText("x2 per bar", x + 6 * 12, y + 170, 10, WHITE);
+}
+
 // Main function
 int main(int argc, char* argv[]) {
   // Replace constants by the ones given in the flags (if present)
@@ -289,8 +535,51 @@ int main(int argc, char* argv[]) {
       DETACHED_MODE = false;
     } else if (arg == "--no-avoid-duplicates") {
       AVOID_DUPLICATES = false;
+    } else if (arg == "--no-priority") {
+      PRIORITIZE_FOCUS = false;
+    } else if (arg == "--prefetch") {
+      PREFETCH_VIEWS = std::max(0, std::stoi(argv[++i]));
+    } else if (arg == "--coloring") {
+      COLORING = getColoringFromName(argv[++i]);
+      if (COLORING < 0) {
+        std::cerr << "Unknown coloring " << argv[i] << " (iterations, distance or histogram)" << std::endl;
+        return 1;
+      }
+    } else if (arg == "--interior") {
+      INTERIOR = getInteriorFromName(argv[++i]);
+      if (INTERIOR < 0) {
+        std::cerr << "Unknown interior mode " << argv[i] << " (off, detect or period)" << std::endl;
+        return 1;
+      }
+    } else if (arg == "--julia-c") {
+      if (!parseComplex(argv[++i], PARAMETERS.juliaRe, PARAMETERS.juliaIm)) {
+        std::cerr << "Invalid Julia c " << argv[i] << " (re,im)" << std::endl;
+        return 1;
+      }
+    } else if (arg == "--phoenix-p") {
+      if (!parseComplex(argv[++i], PARAMETERS.phoenixRe, PARAMETERS.phoenixIm)) {
+        std::cerr << "Invalid Phoenix p " << argv[i] << " (re,im)" << std::endl;
+        return 1;
+      }
+    } else if (arg == "--lyapunov-sequence") {
+      if (!parseLyapunovSequence(argv[++i], PARAMETERS)) {
+        std::cerr << "Invalid Lyapunov sequence " << argv[i] << " (A and B, up to " << LYAPUNOV_MAX_SEQUENCE << " letters)" << std::endl;
+        return 1;
+      }
+    } else if (arg == "--lyapunov-warmup") {
+      PARAMETERS.lyapunovWarmup = std::max(0, std::stoi(argv[++i]));
+    } else if (arg == "--julia-preview") {
+      JULIA_PREVIEW = true;
+    } else if (arg == "--aa") {
+      AA_SAMPLES = std::max(0, std::stoi(argv[++i]));
+    } else if (arg == "--reproject") {
+      REPROJECT = true;
     } else if (arg == "--no-old-textures") {
       USE_OLD_TEXTURES = false;
+    } else if (arg == "--perf") {
+      SHOW_PERFORMANCE = true;
+    } else if (arg == "--trace") {
+      TRACE_PATH = argv[++i];
     } else if (arg == "--zoom") {
       zoom = std::stold(argv[++i]);
     } else if (arg == "--x") {
@@ -323,6 +612,15 @@ int main(int argc, char* argv[]) {
   TILE_HEIGHT = SCREEN_HEIGHT / TILES_Y;
   HALF_SCREEN_WIDTH = SCREEN_WIDTH / 2.0;
   HALF_SCREEN_HEIGHT = SCREEN_HEIGHT / 2.0;
+  scheduler.avoidDuplicates = AVOID_DUPLICATES;
+  scheduler.prioritizeFocus = PRIORITIZE_FOCUS;
+  // The next views have the same tiles at other positions
+  prefetchScheduler.avoidDuplicates = false;
+  prefetchScheduler.prioritizeFocus = PRIORITIZE_FOCUS;
+  if (!TRACE_PATH.empty()) {
+    startTrace(TRACE_PATH);
+    traceThreadName("main");
+  }
   const float cameraMovementPerFrame = cameraSpeed / TARGET_FPS;
   const float zoomPerFrame = zoomSpeed / TARGET_FPS;
 
@@ -338,13 +636,56 @@ int main(int argc, char* argv[]) {
     }
   }
 
+  // Grid of Julia previews, the closest ones to the cursor first
+  JuliaPreviewCache previewCache(PREVIEW_SIZE, PREVIEW_CACHE_SIZE);
+  std::vector<PreviewCell> previewCells;
+  for (int j = -PREVIEW_RADIUS; j <= PREVIEW_RADIUS; j++) {
+    for (int i = -PREVIEW_RADIUS; i <= PREVIEW_RADIUS; i++) {
+      PreviewCell cell;
+      cell.i = i;
+      cell.j = j;
+      cell.texture = LoadRenderTexture(PREVIEW_SIZE, PREVIEW_SIZE);
+      previewCells.push_back(cell);
+    }
+  }
+  // View a Julia set was opened from with a click, J goes back to it
+  bool juliaOpened = false;
+  int returnSet = SET;
+  long double returnX = 0, returnY = 0, returnZoom = 0;
+
   // Needed to detect camera and zoom change
   long double prevCamX = cameraX;
   long double prevCamY = cameraY;
   long double prevZoom = zoom;
+  // Camera of the last frame, to know how fast it moves
+  long double lastFrameCamX = cameraX;
+  long double lastFrameCamY = cameraY;
+  long double lastFrameZoom = zoom;
   int generation = 0;
   float maxIterations = MAX_ITERATIONS;
   bool showPointer = false;
+  // Keys and view the prefetched views were predicted from, and the prefetched tiles being computed
+  CameraKeys prefetchKeys;
+  int prefetchGeneration = -1;
+  std::unordered_set<TileKey, TileKeyHash> tilesPrefetching;
+
+  // Computed tiles, and what the performance overlay shows (refreshed every second)
+  // Enough buffers for every thread (or every tile without detached mode), one waiting upload per tile and the whole cache
+  int tileCount = TILES_X * TILES_Y;
+  bufferPool = std::make_unique<TileBufferPool>(std::max(MAX_THREADS, tileCount) + tileCount + TILE_CACHE_SIZE, TILE_WIDTH * TILE_HEIGHT);
+  TileCache tileCache(TILE_CACHE_SIZE, [](Color *pixels) { bufferPool->release(pixels); });
+  completedTiles = std::make_unique<CompletionQueue<CompletedTile>>(bufferPool->getBufferCount());
+  // Newest pixels taken from the queue for each tile, and the tiles that got some this frame
+  std::vector<CompletedTile> newestPixels(tileCount);
+  std::vector<int> changedTiles;
+  changedTiles.reserve(tileCount);
+  const int tileBytes = TILE_WIDTH * TILE_HEIGHT * sizeof(Color);
+  auto statsStart = std::chrono::steady_clock::now();
+  long long statsIterations = 0;
+  int statsFrames = 0;
+  long long statsBytesUploaded = 0;
+  float iterationsPerSecond = 0;
+  float bytesUploadedPerFrame = 0;
 
   // Make it easier to call the function
   auto customUpdateTilesParallel = [&prevCamX, &prevCamY, &prevZoom, &maxIterations, &generation]() {
@@ -360,23 +701,64 @@ int main(int argc, char* argv[]) {
 
   // Main loop
   while (!WindowShouldClose()) {
+    TraceScope frameTrace("frame", -1, generation);
+
     // Camera movement and zoom
-    if (IsKeyDown(KEY_W)) { cameraY -= cameraMovementPerFrame / zoom; }
-    if (IsKeyDown(KEY_S)) { cameraY += cameraMovementPerFrame / zoom; }
-    if (IsKeyDown(KEY_A)) { cameraX -= cameraMovementPerFrame / zoom; }
-    if (IsKeyDown(KEY_D)) { cameraX += cameraMovementPerFrame / zoom; }
-    if (IsKeyDown(KEY_UP)) { zoom *= (1 + zoomPerFrame); }
-    if (IsKeyDown(KEY_DOWN)) { zoom *= (1 - zoomPerFrame); }
+    CameraKeys keys;
+    keys.up = IsKeyDown(KEY_W);
+    keys.down = IsKeyDown(KEY_S);
+    keys.left = IsKeyDown(KEY_A);
+    keys.right = IsKeyDown(KEY_D);
+    keys.zoomIn = IsKeyDown(KEY_UP);
+    keys.zoomOut = IsKeyDown(KEY_DOWN);
+    moveCamera(cameraX, cameraY, zoom, keys, cameraMovementPerFrame, zoomPerFrame);
     if (IsKeyPressed(KEY_V)) { showPointer = !showPointer; }
     // Debug tools
     if (IsKeyPressed(KEY_LEFT_SHIFT)) { SHOW_TILES = !SHOW_TILES; }
+    if (IsKeyPressed(KEY_H)) { SHOW_PERFORMANCE = !SHOW_PERFORMANCE; }
+    if (IsKeyPressed(KEY_E)) { // Change coloring
+      COLORING = (COLORING + 1) % COLORING_COUNT;
+      customUpdateTilesParallel();
+    }
+    if (IsKeyPressed(KEY_I)) { // Change interior detection
+      INTERIOR = (INTERIOR + 1) % INTERIOR_COUNT;
+      customUpdateTilesParallel();
+    }
+    if (IsKeyPressed(KEY_J)) { // Julia previews, or back to the view the Julia set was opened from
+      if (juliaOpened && SET == SET_JULIA) {
+        SET = returnSet;
+        cameraX = returnX;
+        cameraY = returnY;
+        zoom = returnZoom;
+        customUpdateTilesParallel();
+      } else {
+        JULIA_PREVIEW = !JULIA_PREVIEW;
+      }
+      juliaOpened = false;
+    }
+    bool previewing = JULIA_PREVIEW && hasJuliaPreviews(SET) && !FULLSCREEN && IsCursorOnScreen();
+    if (previewing && IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) { // Open the Julia set of the preview under the cursor
+      getPreviewParameter(GetMousePosition(), 0, 0, PARAMETERS.juliaRe, PARAMETERS.juliaIm);
+      std::cout << TextFormat("Julia c: %.18f,%.18f", (double) PARAMETERS.juliaRe, (double) PARAMETERS.juliaIm) << std::endl;
+      juliaOpened = true;
+      returnSet = SET;
+      returnX = cameraX;
+      returnY = cameraY;
+      returnZoom = zoom;
+      SET = SET_JULIA;
+      cameraX = 0;
+      cameraY = 0;
+      zoom = SCREEN_WIDTH / 3;
+      previewing = false;
+      customUpdateTilesParallel();
+    }
     if (IsKeyPressed(KEY_O)) { // Change set (-1)
-      SET = (SET - 1) % 7;
-      if (SET < 0) { SET = 7 + SET; }
+      SET = (SET - 1) % SET_COUNT;
+      if (SET < 0) { SET = SET_COUNT + SET; }
       customUpdateTilesParallel();
     }
     if (IsKeyPressed(KEY_P)) { // Change set (+1)
-      SET = (SET + 1) % 7;
+      SET = (SET + 1) % SET_COUNT;
       customUpdateTilesParallel();
     }
     if (IsKeyPressed(KEY_LEFT)) { // Change number of iterations
@@ -393,6 +775,9 @@ int main(int argc, char* argv[]) {
       zoom = SCREEN_WIDTH / 3;
       customUpdateTilesParallel();
     }
+    if (IsKeyPressed(KEY_T) && isTracing()) { // Write the trace so far
+      writeTrace();
+    }
     if (IsKeyPressed(KEY_C)) { // Output camera position and zoom
       std::cout << TextFormat("Zoom: %.36f", (float) zoom) << std::endl;
       std::cout << TextFormat("Camera X: %.36f", (float) cameraX) << std::endl;
@@ -400,64 +785,198 @@ int main(int argc, char* argv[]) {
     }
 
     // Automatically re-render the fractal if the view moved too much
-    float acceptedChange = cameraAcceptedChange / zoom;
-    if (IsKeyPressed(KEY_SPACE) || abs(cameraX - prevCamX) >= acceptedChange || abs(cameraY - prevCamY) >= acceptedChange || abs(1 - (zoom / prevZoom)) >= zoomAcceptedChange) {
+    if (IsKeyPressed(KEY_SPACE) || viewMovedTooMuch(cameraX, cameraY, zoom, prevCamX, prevCamY, prevZoom)) {
       customUpdateTilesParallel();
     }
 
-    // Start to render pending tiles
-    while (runningThreads.load(std::memory_order_relaxed) < MAX_THREADS && !pendingTiles.empty()) {
-      PendingTile next = pendingTiles.front();
-      pendingTiles.pop_front();
-      tilesScheduled.erase(next.index);
+    // Predict the next views again when the movement changes (what was queued for the old one is dropped) or when a view was started
+    if (PREFETCH_VIEWS > 0 && (keys != prefetchKeys || generation != prefetchGeneration)) {
+      prefetchViews(keys, cameraX, cameraY, zoom, prevCamX, prevCamY, prevZoom, maxIterations, cameraMovementPerFrame, zoomPerFrame);
+      prefetchKeys = keys;
+      prefetchGeneration = generation;
+    }
+
+    // Tell the scheduler where the user is looking (the cursor, or the centre) and where the camera is going
+    if (PRIORITIZE_FOCUS) {
+      float frameTime = std::max(GetFrameTime(), 0.001f);
+      Vector2 cursor = GetMousePosition();
+      bool useCursor = !FULLSCREEN && IsCursorOnScreen();
+      TileFocus focus;
+      focus.x = useCursor ? cursor.x / TILE_WIDTH : TILES_X / 2.0f;
+      focus.y = useCursor ? cursor.y / TILE_HEIGHT : TILES_Y / 2.0f;
+      focus.velocityX = (float) ((cameraX - lastFrameCamX) * zoom / TILE_WIDTH / frameTime);
+      focus.velocityY = (float) ((cameraY - lastFrameCamY) * zoom / TILE_HEIGHT / frameTime);
+      focus.zoomRate = (float) (std::log(zoom / lastFrameZoom) / frameTime);
+      scheduler.setFocus(focus);
+      prefetchScheduler.setFocus(focus);
+    }
+    lastFrameCamX = cameraX;
+    lastFrameCamY = cameraY;
+    lastFrameZoom = zoom;
 
+    // Julia previews go before the tiles, so they keep up with the cursor
+    if (previewing) {
+      updateJuliaPreviews(previewCells, previewCache, GetMousePosition(), std::min(maxIterations, PREVIEW_ITERATIONS));
+    }
+
+    // Tiles deferred on the last frames go first, only the newest request of each (and not if a newer view of it was started since)
+    std::vector<PendingTile> deferred;
+    deferred.swap(deferredTiles);
+    std::vector<bool> started(tiles.size(), false);
+    for (auto it = deferred.rbegin(); it != deferred.rend(); ++it) {
+      if (started[it->index] || it->generation - tiles[it->index].generation < 0) { continue; }
+      started[it->index] = true;
+      startTile(*it);
+    }
+
+    // Start to render pending tiles
+    PendingTile next;
+    while (renderPool.getBusy() < renderPool.getThreadCount() && bufferPool->getCount(TileBufferPool::FREE) > 0 && scheduler.pop(next)) {
       // Check that the tile has not already been computed by a newer generation
       Tile &tile = tiles[next.index];
       if (next.generation - tile.generation >= 0) {
-        std::thread(computeTileThread, next.index, next.cx, next.cy, next.cz, next.generation, next.maxIterations).detach();
+        // Show it again if it was computed recently
+        const Color *cached = tileCache.find({SET, next.index, next.maxIterations, next.cx, next.cy, next.cz, COLORING, INTERIOR, PARAMETERS});
+        if (cached != nullptr) {
+          Color *pixels = bufferPool->acquire();
+          if (pixels == nullptr) {
+            deferredTiles.push_back(next);
+            break;
+          }
+          std::copy(cached, cached + (int) (TILE_WIDTH * TILE_HEIGHT), pixels);
+          tile.generation = next.generation;
+          saveTilePixels({next.index, next.generation, pixels, next.cx, next.cy, next.cz, SET, next.maxIterations, COLORING, INTERIOR, PARAMETERS});
+          continue;
+        }
+
+        startTile(next);
       }
     }
 
-    // Iterate trough each tile to check if needed to copy pixels to texture
-    for (auto &tile : tiles) {
-      if (!tile.hasComputed) { continue; }
-      {
-        std::lock_guard<std::mutex> lock(tile.texMutex);
-
-        // To not get visual glitches
-        if (USE_OLD_TEXTURES) {
-          // Draw oldTexture on veryOldTexture
-          BeginTextureMode(tile.veryOldTexture);
-          DrawTexturePro(tile.oldTexture.texture,
-                         {0, TILE_HEIGHT, TILE_WIDTH, -TILE_HEIGHT},
-                         {0, 0, TILE_WIDTH, TILE_HEIGHT},
-                         {0, 0}, 0, WHITE);
-          EndTextureMode();
-          tile.veryOldX = tile.oldX;
-          tile.veryOldY = tile.oldY;
-          tile.veryOldZ = tile.oldZ;
-
-          // Draw texture on oldTexture
-          BeginTextureMode(tile.oldTexture);
-          DrawTexturePro(tile.texture.texture,
-                         {0, TILE_HEIGHT, TILE_WIDTH, -TILE_HEIGHT},
-                         {0, 0, TILE_WIDTH, TILE_HEIGHT},
-                         {0, 0}, 0, WHITE);
-          EndTextureMode();
-          tile.oldX = tile.x;
-          tile.oldY = tile.y;
-          tile.oldZ = tile.z;
+    // Threads left idle compute the next views, straight into the tile cache
+    while (scheduler.empty() && renderPool.getBusy() < renderPool.getThreadCount() && bufferPool->getCount(TileBufferPool::FREE) > 0 &&
+           prefetchScheduler.pop(next)) {
+      TileKey key = {SET, next.index, next.maxIterations, next.cx, next.cy, next.cz, COLORING, INTERIOR, PARAMETERS};
+      if (tileCache.contains(key) || !tilesPrefetching.insert(key).second) { continue; }
+      if (!startTile(next, true)) { tilesPrefetching.erase(key); }
+    }
+
+    // Take the finished tiles, only keeping the newest pixels of each tile
+    CompletedTile completed;
+    while (completedTiles->pop(completed)) {
+      if (completed.prefetch) {
+        // Even if the movement changed since, the view may still come
+        TileKey key = {completed.set, completed.index, completed.maxIterations, completed.cx, completed.cy, completed.cz, completed.coloring, completed.interior,
+                     completed.parameters};
+        tilesPrefetching.erase(key);
+        bufferPool->markCached(completed.pixels);
+        tileCache.put(key, completed.pixels);
+        tilesPrefetched++;
+        continue;
+      }
+
+      // Once every tile of the newest view is back (even from the cache, without samples), it can seed the next ones
+      if (newestSamples != nullptr && completed.generation == newestSamples->generation) {
+        if (!completed.sampled) {
+          // Whatever an older view left there must not be used as a prediction
+          PointSample missing;
+          missing.n = -1;
+          Tile &tile = tiles[completed.index];
+          for (int j = 0; j < TILE_HEIGHT; j++) {
+            PointSample *row = &newestSamples->frame.samples[(int) (tile.tileY * TILE_HEIGHT + j) * SCREEN_WIDTH + (int) (tile.tileX * TILE_WIDTH)];
+            std::fill(row, row + (int) TILE_WIDTH, missing);
+          }
         }
+        if (++newestSamples->tilesDone == tileCount) { completeSamples = newestSamples; }
+      }
 
-        // Save the old camera position from when it was computed
-        UpdateTexture(tile.texture.texture, tile.pixels);
-        tile.x = (tile.tileX * TILE_WIDTH - HALF_SCREEN_WIDTH) / tile.cz + tile.cx;
-        tile.y = (tile.tileY * TILE_HEIGHT - HALF_SCREEN_HEIGHT) / tile.cz + tile.cy;
-        tile.z = tile.cz;
+      CompletedTile &newest = newestPixels[completed.index];
+      if (completed.generation < tiles[completed.index].generation || (newest.pixels != nullptr && completed.generation < newest.generation)) {
+        // A newer generation of this tile was already started or computed
+        tilesWasted.fetch_add(1, std::memory_order_relaxed);
+        traceInstant("discard", completed.index, completed.generation);
+        bufferPool->release(completed.pixels);
+        continue;
+      }
 
-        delete[] tile.pixels;
-        tile.hasComputed = false;
+      if (newest.pixels == nullptr) {
+        changedTiles.push_back(completed.index);
+      } else {
+        // The previous pixels were never uploaded
+        tilesWasted.fetch_add(1, std::memory_order_relaxed);
+        bufferPool->release(newest.pixels);
       }
+      newest = completed;
+    }
+
+    // Copy the pixels of the tiles that changed to their texture
+    int bytesUploaded = 0;
+    for (int index : changedTiles) {
+      Tile &tile = tiles[index];
+      CompletedTile &newest = newestPixels[index];
+      TraceScope trace("upload", index, newest.generation);
+
+      // To not get visual glitches
+      if (USE_OLD_TEXTURES) {
+        // Draw oldTexture on veryOldTexture
+        BeginTextureMode(tile.veryOldTexture);
+        DrawTexturePro(tile.oldTexture.texture,
+                       {0, TILE_HEIGHT, TILE_WIDTH, -TILE_HEIGHT},
+                       {0, 0, TILE_WIDTH, TILE_HEIGHT},
+                       {0, 0}, 0, WHITE);
+        EndTextureMode();
+        tile.veryOldX = tile.oldX;
+        tile.veryOldY = tile.oldY;
+        tile.veryOldZ = tile.oldZ;
+
+        // Draw texture on oldTexture
+        BeginTextureMode(tile.oldTexture);
+        DrawTexturePro(tile.texture.texture,
+                       {0, TILE_HEIGHT, TILE_WIDTH, -TILE_HEIGHT},
+                       {0, 0, TILE_WIDTH, TILE_HEIGHT},
+                       {0, 0}, 0, WHITE);
+        EndTextureMode();
+        tile.oldX = tile.x;
+        tile.oldY = tile.y;
+        tile.oldZ = tile.z;
+      }
+
+      // Save the old camera position from when it was computed
+      UpdateTexture(tile.texture.texture, newest.pixels);
+      bytesUploaded += tileBytes;
+      tile.x = (tile.tileX * TILE_WIDTH - HALF_SCREEN_WIDTH) / newest.cz + newest.cx;
+      tile.y = (tile.tileY * TILE_HEIGHT - HALF_SCREEN_HEIGHT) / newest.cz + newest.cy;
+      tile.z = newest.cz;
+
+      // Tiles computed for the newest view can be recolored from their samples, the ones from the cache keep their colors
+      tile.samplesGeneration = -1;
+      if (newestSamples != nullptr && newestSamples->histogram != nullptr && newest.generation == newestSamples->generation && newest.sampled) {
+        tile.samplesGeneration = newest.generation;
+      }
+
+      // Keep the pixels in case this view comes back
+      bufferPool->markCached(newest.pixels);
+      tileCache.put({newest.set, index, newest.maxIterations, newest.cx, newest.cy, newest.cz, newest.coloring, newest.interior, newest.parameters},
+                    newest.pixels);
+      newest.pixels = nullptr;
+    }
+    changedTiles.clear();
+    if (newestSamples != nullptr && newestSamples->histogram != nullptr) {
+      updateHistogram(*newestSamples);
+    }
+
+    // Refresh the rates of the performance overlay
+    statsFrames++;
+    statsBytesUploaded += bytesUploaded;
+    float statsSeconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - statsStart).count();
+    if (statsSeconds >= 1) {
+      long long iterations = iterationsDone.load(std::memory_order_relaxed);
+      iterationsPerSecond = (iterations - statsIterations) / statsSeconds;
+      bytesUploadedPerFrame = (float) statsBytesUploaded / statsFrames;
+      statsIterations = iterations;
+      statsFrames = 0;
+      statsBytesUploaded = 0;
+      statsStart = std::chrono::steady_clock::now();
     }
 
     // Actual drawing
@@ -468,83 +987,79 @@ int main(int argc, char* argv[]) {
     if (USE_OLD_TEXTURES) {
       // Very old texture
       for (auto &tile : tiles) {
-        {
-          std::lock_guard<std::mutex> lock(tile.texMutex);
-
-          // Calculate the right position to show the old pixels, based on where they were computed
-          float x = (tile.veryOldX - cameraX) * zoom + HALF_SCREEN_WIDTH;
-          float y = (tile.veryOldY - cameraY) * zoom + HALF_SCREEN_HEIGHT;
-          float w = TILE_WIDTH / tile.veryOldZ * zoom;
-          float h = TILE_HEIGHT / tile.veryOldZ * zoom;
-
-          DrawTexturePro(tile.veryOldTexture.texture,
-                         {0, 0, TILE_WIDTH, TILE_HEIGHT},
-                         {x, y, w, h},
-                         {0, 0}, 0, WHITE);
-
-          // Only for debug
-          if (SHOW_TILES) {
-            DrawRectangleLines(x, y, w, h, GREEN);
-          }
+        // Calculate the right position to show the old pixels, based on where they were computed
+        float x = (tile.veryOldX - cameraX) * zoom + HALF_SCREEN_WIDTH;
+        float y = (tile.veryOldY - cameraY) * zoom + HALF_SCREEN_HEIGHT;
+        float w = TILE_WIDTH / tile.veryOldZ * zoom;
+        float h = TILE_HEIGHT / tile.veryOldZ * zoom;
+
+        DrawTexturePro(tile.veryOldTexture.texture,
+                       {0, 0, TILE_WIDTH, TILE_HEIGHT},
+                       {x, y, w, h},
+                       {0, 0}, 0, WHITE);
+
+        // Only for debug
+        if (SHOW_TILES) {
+          DrawRectangleLines(x, y, w, h, GREEN);
         }
       }
 
       // Old texture
       for (auto &tile : tiles) {
-        {
-          std::lock_guard<std::mutex> lock(tile.texMutex);
-
-          // Calculate the right position to show the old pixels, based on where they were computed
-          float x = (tile.oldX - cameraX) * zoom +  HALF_SCREEN_WIDTH;
-          float y = (tile.oldY - cameraY) * zoom + HALF_SCREEN_HEIGHT;
-          float w = TILE_WIDTH / tile.oldZ * zoom;
-          float h = TILE_HEIGHT / tile.oldZ * zoom;
-
-          DrawTexturePro(tile.oldTexture.texture,
-                         {0, 0, TILE_WIDTH, TILE_HEIGHT},
-                         {x, y, w, h},
-                         {0, 0}, 0, WHITE);
-
-          // Only for debug
-          if (SHOW_TILES) {
-            DrawRectangleLines(x, y, w, h, RED);
-          }
-        }
-      }
-    }
+        // Calculate the right position to show the old pixels, based on where they were computed
+        float x = (tile.oldX - cameraX) * zoom +  HALF_SCREEN_WIDTH;
+        float y = (tile.oldY - cameraY) * zoom + HALF_SCREEN_HEIGHT;
+        float w = TILE_WIDTH / tile.oldZ * zoom;
+        float h = TILE_HEIGHT / tile.oldZ * zoom;
 
-    // Draw all tiles
-    for (auto &tile : tiles) {
-      {
-        std::lock_guard<std::mutex> lock(tile.texMutex);
-
-        // Calculate the right position to show the pixels, based on where they were computed
-        float x = (tile.x - cameraX) * zoom + HALF_SCREEN_WIDTH;
-        float y = (tile.y - cameraY) * zoom + HALF_SCREEN_HEIGHT;
-        float w = TILE_WIDTH / tile.z * zoom;
-        float h = TILE_HEIGHT / tile.z * zoom;
-
-        DrawTexturePro(tile.texture.texture,
+        DrawTexturePro(tile.oldTexture.texture,
                        {0, 0, TILE_WIDTH, TILE_HEIGHT},
                        {x, y, w, h},
                        {0, 0}, 0, WHITE);
 
         // Only for debug
         if (SHOW_TILES) {
-          DrawRectangleLines(x, y, w, h, BLUE);
+          DrawRectangleLines(x, y, w, h, RED);
         }
       }
     }
 
+    // Draw all tiles
+    for (auto &tile : tiles) {
+      // Calculate the right position to show the pixels, based on where they were computed
+      float x = (tile.x - cameraX) * zoom + HALF_SCREEN_WIDTH;
+      float y = (tile.y - cameraY) * zoom + HALF_SCREEN_HEIGHT;
+      float w = TILE_WIDTH / tile.z * zoom;
+      float h = TILE_HEIGHT / tile.z * zoom;
+
+      DrawTexturePro(tile.texture.texture,
+                     {0, 0, TILE_WIDTH, TILE_HEIGHT},
+                     {x, y, w, h},
+                     {0, 0}, 0, WHITE);
+
+      // Only for debug
+      if (SHOW_TILES) {
+        DrawRectangleLines(x, y, w, h, BLUE);
+      }
+    }
+
+    if (previewing) {
+      drawJuliaPreviews(previewCells, GetMousePosition());
+    }
+
     // Draw UI
     DrawText(TextFormat("Iterations: %.0f", maxIterations), 10, 10, 20, WHITE);
     DrawText(TextFormat("Generation: %.0f", (float) generation), 10, 30, 20, WHITE);
     DrawText(TextFormat("Tiles: %.0f", (float) (TILES_X * TILES_Y)), 10, 50, 20, WHITE);
 
-    DrawText(TextFormat("Threads: %.0f", (float) runningThreads.load(std::memory_order_relaxed)), SCREEN_WIDTH - 10 - MeasureText(TextFormat("Threads: %.0f", (float) runningThreads.load(std::memory_order_relaxed)), 20), 10, 20, WHITE);
-    DrawText(TextFormat("Queue: %.0f", (float) pendingTiles.size()), SCREEN_WIDTH - 10 - MeasureText(TextFormat("Queue: %.0f", (float) pendingTiles.size()), 20), 30, 20, WHITE);
+    DrawText(TextFormat("Threads: %.0f", (float) renderPool.getBusy()), SCREEN_WIDTH - 10 - MeasureText(TextFormat("Threads: %.0f", (float) renderPool.getBusy()), 20), 10, 20, WHITE);
+    DrawText(TextFormat("Queue: %.0f", (float) scheduler.size()), SCREEN_WIDTH - 10 - MeasureText(TextFormat("Queue: %.0f", (float) scheduler.size()), 20), 30, 20, WHITE);
     DrawText(TextFormat("FPS: %.0f", (float) GetFPS()), SCREEN_WIDTH - 10 - MeasureText(TextFormat("FPS: %.0f", (float) GetFPS()), 20), 50, 20, WHITE);
 
+    if (SHOW_PERFORMANCE) {
+      drawPerformanceOverlay(10, 80, iterationsPerSecond, tileCache, bytesUploaded, bytesUploadedPerFrame);
+    }
+
     DrawText(TextFormat("Camera X: %.15f", (float) cameraX), 10, SCREEN_HEIGHT - 70, 20, WHITE);
     DrawText(TextFormat("Camera Y: %.15f", (float) cameraY), 10, SCREEN_HEIGHT - 50, 20, WHITE);
     DrawText(TextFormat("Zoom: %.2f | %.2f", zoom, zoom / prevZoom), 10, SCREEN_HEIGHT - 30, 20, WHITE);
@@ -564,8 +1079,14 @@ int main(int argc, char* argv[]) {
     UnloadRenderTexture(tile.oldTexture);
     UnloadRenderTexture(tile.veryOldTexture);
   }
+  for (PreviewCell &cell : previewCells) {
+    UnloadRenderTexture(cell.texture);
+  }
 
   CloseWindow();
+  if (isTracing()) {
+    writeTrace();
+  }
 
   // To then copy and paste if needed
   std::cout << "## Final view ##" << std::endl;
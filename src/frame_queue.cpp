@@ -0,0 +1,146 @@
+#include "frame_queue.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <ctime>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/stat.h>
+
+
+std::string FrameQueue::getPath(int chunk, const char *extension) const {
+  char filename[32];
+  snprintf(filename, sizeof(filename), "/chunk%05d.%s", chunk, extension);
+  return directory + filename;
+}
+
+// Host and process id, unique among the workers sharing the directory
+std::string FrameQueue::getOwnerName() {
+  char hostname[256] = "unknown";
+  gethostname(hostname, sizeof(hostname) - 1);
+  return std::string(hostname) + "." + std::to_string((int) getpid());
+}
+
+// Only one worker can create the claim file, even across machines sharing the directory
+bool FrameQueue::createClaim(int chunk) const {
+  int fd = ::open(getPath(chunk, "claim").c_str(), O_CREAT | O_EXCL | O_WRONLY, 0644);
+  if (fd < 0) { return false; }
+
+  // Same name as in the temporary files of the worker
+  std::string owner = getOwnerName() + "\n";
+  if (write(fd, owner.data(), owner.size()) != (ssize_t) owner.size()) {
+    std::cerr << "Could not write the owner of chunk " << chunk << std::endl;
+  }
+  close(fd);
+  return true;
+}
+
+bool FrameQueue::open(const std::string &jobSignature) {
+  mkdir(directory.c_str(), 0755);
+
+  // Chunks are only meaningful if every worker splits the same video the same way
+  std::string description = jobSignature + " chunks " + std::to_string(chunkSize);
+  std::string path = directory + "/queue.txt";
+  std::string tempPath = path + "." + std::to_string((int) getpid()) + ".tmp";
+  {
+    std::ofstream file(tempPath);
+    file << description << "\n";
+    if (!file.good()) {
+      std::cerr << "Could not write " << tempPath << std::endl;
+      return false;
+    }
+  }
+
+  // link() fails if the description already exists, so the first worker wins and the others compare with it
+  bool created = link(tempPath.c_str(), path.c_str()) == 0;
+  std::remove(tempPath.c_str());
+  if (created) { return true; }
+
+  std::ifstream file(path);
+  std::string existing;
+  std::getline(file, existing);
+  if (existing != description) {
+    std::cerr << path << " was made for another job (or chunk size), use another queue directory" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+int FrameQueue::chunkCount() const {
+  return (frameCount + chunkSize - 1) / chunkSize;
+}
+
+int FrameQueue::chunkBegin(int chunk) const {
+  return chunk * chunkSize;
+}
+
+int FrameQueue::chunkEnd(int chunk) const {
+  int end = (chunk + 1) * chunkSize;
+  return end < frameCount ? end : frameCount;
+}
+
+int FrameQueue::claimChunk() {
+  for (int chunk = 0; chunk < chunkCount(); chunk++) {
+    if (isDone(chunk)) { continue; }
+    if (createClaim(chunk)) { return chunk; }
+
+    // Take over the chunk if its worker is gone
+    struct stat info;
+    std::string claimPath = getPath(chunk, "claim");
+    if (stat(claimPath.c_str(), &info) != 0 || time(nullptr) - info.st_mtime < staleAfter) { continue; }
+
+    // Moving the claim is atomic, but another worker may have replaced the stale claim since the stat
+    // So check what was moved: a fresh claim goes back (link() fails if the chunk was claimed again meanwhile)
+    std::string stalePath = claimPath + ".stale." + getOwnerName();
+    if (std::rename(claimPath.c_str(), stalePath.c_str()) != 0) { continue; }
+    bool stale = stat(stalePath.c_str(), &info) == 0 && time(nullptr) - info.st_mtime >= staleAfter;
+    if (!stale) { link(stalePath.c_str(), claimPath.c_str()); }
+    std::remove(stalePath.c_str());
+
+    // Races like everybody else to re-create the claim
+    if (stale && createClaim(chunk)) {
+      std::cout << "Took over abandoned chunk " << chunk << std::endl;
+      return chunk;
+    }
+  }
+  return -1;
+}
+
+int FrameQueue::findStraggler() const {
+  // Oldest claims first
+  std::vector<std::pair<time_t, int>> stragglers;
+  for (int chunk = 0; chunk < chunkCount(); chunk++) {
+    struct stat info;
+    if (isDone(chunk) || stat(getPath(chunk, "claim").c_str(), &info) != 0) { continue; }
+    stragglers.push_back({info.st_mtime, chunk});
+  }
+  if (stragglers.empty()) { return -1; }
+  std::sort(stragglers.begin(), stragglers.end());
+
+  // Each helper picks by its pid, so several idle workers spread over the stragglers instead of all joining the oldest
+  return stragglers[getpid() % stragglers.size()].second;
+}
+
+void FrameQueue::heartbeat(int chunk) const {
+  utime(getPath(chunk, "claim").c_str(), nullptr);
+}
+
+void FrameQueue::markDone(int chunk) const {
+  std::ofstream file(getPath(chunk, "done"));
+}
+
+bool FrameQueue::isDone(int chunk) const {
+  struct stat info;
+  return stat(getPath(chunk, "done").c_str(), &info) == 0;
+}
+
+bool FrameQueue::allDone() const {
+  for (int chunk = 0; chunk < chunkCount(); chunk++) {
+    if (!isDone(chunk)) { return false; }
+  }
+  return true;
+}
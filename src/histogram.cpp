@@ -0,0 +1,101 @@
+#include "histogram.hpp"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+// Below this many counts to sum, starting threads costs more than the sum
+static const size_t PARALLEL_REDUCE_MIN = 1 << 16;
+
+int getHistogramBinCount(float maxIterations) {
+  return std::max(1, std::min((int) maxIterations, MAX_HISTOGRAM_BINS));
+}
+
+HistogramPalette::HistogramPalette(const IterationHistogram &histogram) : levels(histogram.counts.size() + 1, 0) {
+  long long total = 0;
+  for (long long count : histogram.counts) { total += count; }
+  long long below = 0;
+  for (size_t bin = 0; bin < histogram.counts.size() && total > 0; bin++) {
+    levels[bin] = (float) ((double) below / total);
+    below += histogram.counts[bin];
+  }
+  if (total > 0) { levels.back() = 1; }
+
+  colors.resize(histogram.counts.size());
+  for (size_t bin = 0; bin < colors.size(); bin++) {
+    colors[bin] = getColorFromLevel(levels[bin]);
+  }
+}
+
+float HistogramPalette::getLevel(const PointSample &sample, float maxIterations) const {
+  int bins = (int) colors.size();
+  if (bins < 1) { return 0; }
+  double position = std::max(0.0, (double) sample.n * bins / maxIterations);
+  int bin = std::min(bins - 1, (int) position);
+  float fraction = std::min(1.0f, (float) (position - bin));
+  return levels[bin] + (levels[bin + 1] - levels[bin]) * fraction;
+}
+
+
+HistogramAccumulator::HistogramAccumulator(float maxIterations, int workers)
+    : maxIterations(maxIterations), bins(getHistogramBinCount(maxIterations)), workers(std::max(1, workers)) {
+  const size_t perLine = 64 / sizeof(std::atomic<unsigned int>);
+  stride = (bins + perLine - 1) / perLine * perLine;
+  counts.reset(new std::atomic<unsigned int>[stride * this->workers]);
+  for (size_t i = 0; i < stride * this->workers; i++) {
+    counts[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+void HistogramAccumulator::add(int worker, const PointSample *samples, int width, int height, int stride) {
+  std::atomic<unsigned int> *own = counts.get() + (size_t) worker * this->stride;
+  for (int j = 0; j < height; j++) {
+    const PointSample *row = samples + (size_t) j * stride;
+    for (int i = 0; i < width; i++) {
+      if (!row[i].escaped || row[i].n < 0) { continue; }
+      int bin = std::min(bins - 1, (int) ((double) row[i].n * bins / maxIterations));
+      // Only this thread writes it, no need for an atomic increment
+      own[bin].store(own[bin].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+  }
+}
+
+IterationHistogram HistogramAccumulator::reduce(int threads) const {
+  IterationHistogram histogram;
+  histogram.counts.assign(bins, 0);
+  auto sumRange = [this, &histogram](int first, int last) {
+    for (int worker = 0; worker < workers; worker++) {
+      const std::atomic<unsigned int> *own = counts.get() + (size_t) worker * stride;
+      for (int bin = first; bin < last; bin++) {
+        histogram.counts[bin] += own[bin].load(std::memory_order_relaxed);
+      }
+    }
+  };
+
+  threads = (int) std::min<size_t>(std::max(1, threads), (size_t) bins * workers / PARALLEL_REDUCE_MIN + 1);
+  if (threads == 1) {
+    sumRange(0, bins);
+    return histogram;
+  }
+
+  // Each thread sums every worker over its own range of bins, nothing is shared
+  std::vector<std::thread> reducers;
+  for (int t = 0; t < threads; t++) {
+    reducers.emplace_back(sumRange, (int) ((long long) bins * t / threads), (int) ((long long) bins * (t + 1) / threads));
+  }
+  for (auto &reducer : reducers) { reducer.join(); }
+  return histogram;
+}
+
+
+// Dark blue, light blue, white, orange, black and back to dark blue
+static const float GRADIENT_POSITIONS[] = {0, 0.16f, 0.42f, 0.6425f, 0.8575f, 1};
+static const Color GRADIENT_COLORS[] = {{0, 7, 100, 255}, {32, 107, 203, 255}, {237, 255, 255, 255}, {255, 170, 0, 255}, {0, 2, 0, 255}, {0, 7, 100, 255}};
+
+Color getColorFromLevel(float level) {
+  level = std::min(1.0f, std::max(0.0f, level));
+  int stop = 0;
+  while (stop + 2 < (int) (sizeof(GRADIENT_POSITIONS) / sizeof(float)) && level > GRADIENT_POSITIONS[stop + 1]) { stop++; }
+  float t = (level - GRADIENT_POSITIONS[stop]) / (GRADIENT_POSITIONS[stop + 1] - GRADIENT_POSITIONS[stop]);
+  const Color &a = GRADIENT_COLORS[stop], &b = GRADIENT_COLORS[stop + 1];
+  return Color{(unsigned char) (a.r + (b.r - a.r) * t), (unsigned char) (a.g + (b.g - a.g) * t), (unsigned char) (a.b + (b.b - a.b) * t), 255};
+}
@@ -0,0 +1,250 @@
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+#include "image_writer.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+static const char *IMAGE_FORMAT_NAMES[IMAGE_FORMAT_COUNT] = {"png", "qoi", "ppm", "pam"};
+
+const char *getImageFormatName(int format) {
+  return format >= 0 && format < IMAGE_FORMAT_COUNT ? IMAGE_FORMAT_NAMES[format] : "unknown";
+}
+
+int getImageFormatFromName(const std::string &name) {
+  for (int format = 0; format < IMAGE_FORMAT_COUNT; format++) {
+    if (name == IMAGE_FORMAT_NAMES[format]) { return format; }
+  }
+  return -1;
+}
+
+static void putBigEndian(std::string &out, unsigned int value) {
+  out += (char) (value >> 24);
+  out += (char) (value >> 16);
+  out += (char) (value >> 8);
+  out += (char) value;
+}
+
+
+// PNG //
+
+static void appendToString(void *context, void *data, int size) {
+  ((std::string *) context)->append((const char *) data, size);
+}
+
+static unsigned int crc32(const unsigned char *data, size_t length, unsigned int crc = 0) {
+  static unsigned int table[256];
+  static std::once_flag tableReady;
+  std::call_once(tableReady, []() {
+    for (unsigned int i = 0; i < 256; i++) {
+      unsigned int c = i;
+      for (int k = 0; k < 8; k++) { c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1; }
+      table[i] = c;
+    }
+  });
+
+  crc = ~crc;
+  for (size_t i = 0; i < length; i++) { crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8); }
+  return ~crc;
+}
+
+static void putPngChunk(std::string &out, const char *type, const std::string &data) {
+  putBigEndian(out, data.size());
+  size_t start = out.size();
+  out.append(type, 4);
+  out += data;
+  putBigEndian(out, crc32((const unsigned char *) out.data() + start, out.size() - start));
+}
+
+// Level 0 : the rows go in stored deflate blocks as they are, only the checksums cost anything
+static bool encodeStoredPng(std::string &out, const unsigned char *data, int width, int height, int channels, int stride) {
+  std::string header;
+  putBigEndian(header, width);
+  putBigEndian(header, height);
+  header += (char) 8;                        // Bits per channel
+  header += (char) (channels == 4 ? 6 : 2); // RGBA or RGB
+  header.append(3, '\0');                    // Deflate, adaptive filtering, not interlaced
+
+  // Filter byte (none) before each row, then Adler-32 of everything
+  size_t rowBytes = (size_t) width * channels;
+  std::string raw;
+  raw.reserve((rowBytes + 1) * height);
+  for (int y = 0; y < height; y++) {
+    raw += '\0';
+    raw.append((const char *) data + (size_t) y * stride, rowBytes);
+  }
+  unsigned int a = 1, b = 0;
+  for (size_t i = 0; i < raw.size(); i++) {
+    a += (unsigned char) raw[i];
+    b += a;
+    // Stays far from overflow, 5552 is what zlib uses
+    if (i % 5552 == 5551) {
+      a %= 65521;
+      b %= 65521;
+    }
+  }
+  a %= 65521;
+  b %= 65521;
+
+  std::string zlib = "\x78\x01";
+  zlib.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+  size_t offset = 0;
+  do {
+    size_t length = std::min<size_t>(raw.size() - offset, 65535);
+    bool last = offset + length == raw.size();
+    zlib += (char) (last ? 1 : 0);
+    zlib += (char) (length & 0xff);
+    zlib += (char) (length >> 8);
+    zlib += (char) (~length & 0xff);
+    zlib += (char) ((~length >> 8) & 0xff);
+    zlib.append(raw, offset, length);
+    offset += length;
+  } while (offset < raw.size());
+  putBigEndian(zlib, (b << 16) | a);
+
+  out.assign("\x89PNG\r\n\x1a\n", 8);
+  putPngChunk(out, "IHDR", header);
+  putPngChunk(out, "IDAT", zlib);
+  putPngChunk(out, "IEND", "");
+  return true;
+}
+
+static bool encodePng(std::string &out, const unsigned char *data, int width, int height, int channels, int stride, const ImageOptions &options) {
+  if (options.pngLevel <= 0) {
+    return encodeStoredPng(out, data, width, height, channels, stride);
+  }
+
+  // stb_image_write keeps these in globals, images encoded at the same time must use the same options
+  static std::mutex optionsMutex;
+  {
+    std::lock_guard<std::mutex> lock(optionsMutex);
+    if (stbi_write_png_compression_level != options.pngLevel) { stbi_write_png_compression_level = options.pngLevel; }
+    if (stbi_write_force_png_filter != options.pngFilter) { stbi_write_force_png_filter = options.pngFilter; }
+  }
+  out.clear();
+  return stbi_write_png_to_func(appendToString, &out, width, height, channels, data, stride) != 0;
+}
+
+
+// QOI (https://qoiformat.org) //
+
+static bool encodeQoi(std::string &out, const unsigned char *data, int width, int height, int channels, int stride) {
+  out.assign("qoif", 4);
+  putBigEndian(out, width);
+  putBigEndian(out, height);
+  out += (char) channels;
+  out += (char) 0; // sRGB
+
+  struct Pixel {
+    unsigned char r, g, b, a;
+    bool operator==(const Pixel &other) const { return r == other.r && g == other.g && b == other.b && a == other.a; }
+  };
+  Pixel seen[64] = {};
+  Pixel previous = {0, 0, 0, 255};
+  int run = 0;
+
+  for (int y = 0; y < height; y++) {
+    const unsigned char *row = data + (size_t) y * stride;
+    for (int x = 0; x < width; x++) {
+      const unsigned char *p = row + x * channels;
+      Pixel pixel = {p[0], p[1], p[2], channels == 4 ? p[3] : (unsigned char) 255};
+
+      if (pixel == previous) {
+        run++;
+        if (run == 62) {
+          out += (char) (0xc0 | (run - 1));
+          run = 0;
+        }
+        continue;
+      }
+      if (run > 0) {
+        out += (char) (0xc0 | (run - 1));
+        run = 0;
+      }
+
+      int hash = (pixel.r * 3 + pixel.g * 5 + pixel.b * 7 + pixel.a * 11) % 64;
+      if (seen[hash] == pixel) {
+        out += (char) hash;
+      } else if (pixel.a == previous.a) {
+        seen[hash] = pixel;
+        signed char dr = pixel.r - previous.r;
+        signed char dg = pixel.g - previous.g;
+        signed char db = pixel.b - previous.b;
+        signed char drg = dr - dg;
+        signed char dbg = db - dg;
+        if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+          out += (char) (0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+        } else if (drg >= -8 && drg <= 7 && dg >= -32 && dg <= 31 && dbg >= -8 && dbg <= 7) {
+          out += (char) (0x80 | (dg + 32));
+          out += (char) ((drg + 8) << 4 | (dbg + 8));
+        } else {
+          out += (char) 0xfe;
+          out.append((const char *) &pixel, 3);
+        }
+      } else {
+        seen[hash] = pixel;
+        out += (char) 0xff;
+        out.append((const char *) &pixel, 4);
+      }
+      previous = pixel;
+    }
+  }
+  if (run > 0) { out += (char) (0xc0 | (run - 1)); }
+  out.append("\0\0\0\0\0\0\0\1", 8);
+  return true;
+}
+
+
+// PPM and PAM (netpbm) //
+
+static bool encodeNetpbm(std::string &out, int format, const unsigned char *data, int width, int height, int channels, int stride) {
+  char header[128];
+  int outChannels = format == IMAGE_PPM ? 3 : channels;
+  if (format == IMAGE_PPM) {
+    snprintf(header, sizeof(header), "P6\n%d %d\n255\n", width, height);
+  } else {
+    snprintf(header, sizeof(header), "P7\nWIDTH %d\nHEIGHT %d\nDEPTH %d\nMAXVAL 255\nTUPLTYPE %s\nENDHDR\n", width, height, channels,
+             channels == 4 ? "RGB_ALPHA" : "RGB");
+  }
+
+  out.assign(header);
+  size_t start = out.size();
+  size_t rowBytes = (size_t) width * outChannels;
+  out.resize(start + rowBytes * height);
+  for (int y = 0; y < height; y++) {
+    const unsigned char *row = data + (size_t) y * stride;
+    char *destination = &out[start + y * rowBytes];
+    if (outChannels == channels) {
+      memcpy(destination, row, rowBytes);
+      continue;
+    }
+    for (int x = 0; x < width; x++) { memcpy(destination + x * 3, row + x * channels, 3); }
+  }
+  return true;
+}
+
+
+bool encodeImage(std::string &out, int format, const unsigned char *data, int width, int height, int channels, int stride,
+                 const ImageOptions &options) {
+  if (width <= 0 || height <= 0 || (channels != 3 && channels != 4)) { return false; }
+  switch (format) {
+    case IMAGE_PNG: return encodePng(out, data, width, height, channels, stride, options);
+    case IMAGE_QOI: return encodeQoi(out, data, width, height, channels, stride);
+    case IMAGE_PPM:
+    case IMAGE_PAM: return encodeNetpbm(out, format, data, width, height, channels, stride);
+    default: return false;
+  }
+}
+
+bool writeImage(const std::string &path, int format, const unsigned char *data, int width, int height, int channels, int stride,
+                const ImageOptions &options) {
+  // Reused by the next image of the thread, frames are all the same size
+  thread_local std::string encoded;
+  if (!encodeImage(encoded, format, data, width, height, channels, stride, options)) { return false; }
+
+  FILE *file = fopen(path.c_str(), "wb");
+  if (file == nullptr) { return false; }
+  bool ok = fwrite(encoded.data(), 1, encoded.size(), file) == encoded.size();
+  return (fclose(file) == 0) && ok;
+}
@@ -0,0 +1,49 @@
+#include "julia_preview.hpp"
+
+// Part of the plane shown by a preview, most Julia sets fit in it
+static const long double PREVIEW_EXTENT = 3.2L;
+
+const Color *JuliaPreviewCache::get(RenderPool &pool, long double re, long double im, float maxIterations) {
+  Key key(re, im, maxIterations);
+  auto found = previews.find(key);
+  if (found != previews.end()) {
+    found->second->lastUsed = ++uses;
+    return found->second->done.load(std::memory_order_acquire) ? found->second->pixels.data() : nullptr;
+  }
+  if (pool.getBusy() >= pool.getThreadCount()) { return nullptr; }
+
+  // Make room first, the previews still computed are owned by their job until it is done
+  while ((int) previews.size() >= capacity && !previews.empty()) {
+    auto oldest = previews.begin();
+    for (auto it = previews.begin(); it != previews.end(); ++it) {
+      if (it->second->lastUsed < oldest->second->lastUsed) { oldest = it; }
+    }
+    previews.erase(oldest);
+  }
+
+  std::shared_ptr<Preview> preview = std::make_shared<Preview>();
+  preview->pixels.resize(size * size);
+  preview->lastUsed = ++uses;
+  previews[key] = preview;
+
+  // Double is enough for the whole set, and the points inside stop as soon as they fell in a cycle
+  RenderView view;
+  view.set = SET_JULIA;
+  view.parameters.juliaRe = re;
+  view.parameters.juliaIm = im;
+  view.precision = PRECISION_DOUBLE;
+  view.zoom = size / PREVIEW_EXTENT;
+  view.width = size;
+  view.height = size;
+  view.maxIterations = maxIterations;
+  view.interior = INTERIOR_DETECT;
+
+  RenderTile tile;
+  tile.width = size;
+  tile.height = size;
+  tile.pixels = preview->pixels.data();
+  pool.submit(view, tile, [preview](const RenderView &, const RenderTile &, const RenderStats &) {
+    preview->done.store(true, std::memory_order_release);
+  });
+  return nullptr;
+}
@@ -0,0 +1,137 @@
+#include "reference_orbit.hpp"
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const char ORBIT_MAGIC[8] = "ORBIT1";
+
+
+ReferenceOrbit::~ReferenceOrbit() {
+  if (mapping != nullptr) {
+    munmap(mapping, mappingSize);
+  }
+}
+
+bool ReferenceOrbit::open(long double centerX, long double centerY, int maxIterations, const std::string &spillPath) {
+  cx = centerX;
+  cy = centerY;
+  // Z_0 = 0, then one point per iteration
+  capacity = maxIterations + 2;
+  mappingSize = sizeof(Header) + (size_t) capacity * sizeof(Point);
+
+  if (capacity < SPILL_THRESHOLD || spillPath.empty()) {
+    // Only touched pages are actually allocated
+    mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  } else {
+    int fd = ::open(spillPath.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+      std::cerr << "Could not open " << spillPath << std::endl;
+      return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || ((size_t) info.st_size < mappingSize && ftruncate(fd, mappingSize) != 0)) {
+      std::cerr << "Could not grow " << spillPath << std::endl;
+      close(fd);
+      return false;
+    }
+    mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+  }
+  if (mapping == MAP_FAILED) {
+    mapping = nullptr;
+    std::cerr << "Could not map a reference orbit of " << capacity << " iterations" << std::endl;
+    return false;
+  }
+
+  header = static_cast<Header *>(mapping);
+  points = reinterpret_cast<Point *>(header + 1);
+
+  // Keep what a previous run computed around the same center
+  bool reusable = memcmp(header->magic, ORBIT_MAGIC, sizeof(ORBIT_MAGIC)) == 0 && header->cx == cx && header->cy == cy &&
+                  header->length > 0 && header->length <= capacity;
+  if (reusable) {
+    std::cout << "Reusing " << header->length << " iterations of reference orbit from " << spillPath << std::endl;
+  } else {
+    memcpy(header->magic, ORBIT_MAGIC, sizeof(ORBIT_MAGIC));
+    header->cx = cx;
+    header->cy = cy;
+    header->zx = 0;
+    header->zy = 0;
+    header->escaped = 0;
+    points[0] = {0, 0};
+    header->length = 1;
+  }
+  length.store(header->length, std::memory_order_release);
+  return true;
+}
+
+void ReferenceOrbit::extend(int iterations) {
+  int target = std::min(iterations + 2, capacity);
+  int n = length.load(std::memory_order_relaxed);
+  long double zx = header->zx;
+  long double zy = header->zy;
+
+  while (n < target && !header->escaped) {
+    long double xx = zx * zx - zy * zy + cx;
+    zy = 2 * zx * zy + cy;
+    zx = xx;
+    points[n] = {(double) zx, (double) zy};
+    n++;
+
+    // Past the escape radius, the orbit is of no use anymore (pixels get re-based instead)
+    if (zx * zx + zy * zy > 16) { header->escaped = 1; }
+
+    // Publish regularly, so readers can already use the beginning of a long orbit
+    if (n % 65536 == 0) {
+      header->length = n;
+      length.store(n, std::memory_order_release);
+    }
+  }
+
+  header->zx = zx;
+  header->zy = zy;
+  header->length = n;
+  length.store(n, std::memory_order_release);
+}
+
+PointSample samplePoint_MandelbrotPerturbed(const ReferenceOrbit &orbit, double dcx, double dcy, float maxIterations) {
+  const ReferenceOrbit::Point *reference = orbit.data();
+  const int last = orbit.size() - 1; // At least Z_1 once extended
+
+  // z_1 = c, so the offset starts at dc with the reference at Z_1
+  double dx = dcx, dy = dcy;
+  int m = 1;
+  int n = 0;
+  while (n < maxIterations) {
+    double zx = reference[m].x + dx;
+    double zy = reference[m].y + dy;
+    double r2 = zx * zx + zy * zy;
+    if (r2 > 16) { break; }
+
+    // Re-base when the pixel gets closer to 0 than to the reference, or when the reference runs out (it escaped or is too short)
+    // Z_0 = 0 so the offset becomes z itself
+    if (r2 < dx * dx + dy * dy || m == last) {
+      dx = zx;
+      dy = zy;
+      m = 0;
+    }
+
+    // dz' = (2Z + dz) * dz + dc
+    double Zx = reference[m].x, Zy = reference[m].y;
+    double tx = 2 * Zx + dx, ty = 2 * Zy + dy;
+    double ndx = tx * dx - ty * dy + dcx;
+    dy = tx * dy + ty * dx + dcy;
+    dx = ndx;
+    m++;
+    n++;
+  }
+
+  PointSample sample;
+  sample.n = n;
+  sample.escaped = n < maxIterations;
+  return sample;
+}
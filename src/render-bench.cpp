@@ -0,0 +1,311 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Own implementations
+#include "sets_definition.hpp"
+#include "tile_scheduler.hpp"
+#include "renderer.hpp"
+#include "completion_queue.hpp"
+
+
+// Constants (changeable with flags)
+int SCREEN_WIDTH = 1600;
+int SCREEN_HEIGHT = 900;
+int TILES_X = 16;
+int TILES_Y = 9;
+int SET = 0;
+int MAX_ITERATIONS = 2000;
+// Views rendered for each thread count, the camera moves one tile to the right between them if PAN is set
+int FRAMES = 3;
+bool PAN = false;
+bool AVOID_DUPLICATES = true;
+// Compute the tiles closest to the centre first (like fractal-viewer), instead of the spiral / sweep order
+bool PRIORITIZE_FOCUS = false;
+// Thread counts to measure (default : powers of two up to the number of cores)
+std::vector<int> THREAD_COUNTS;
+// Where to write the results (nothing if empty)
+std::string JSON_PATH = "";
+
+long double cameraX = 0;
+long double cameraY = 0;
+long double zoom = 500;
+
+float TILE_WIDTH, TILE_HEIGHT;
+float HALF_SCREEN_WIDTH, HALF_SCREEN_HEIGHT;
+
+// Same as the tiles of fractal-viewer, without the textures
+struct Tile {
+  int tileX, tileY;
+  int generation = 0;
+};
+std::vector<Tile> tiles;
+
+// Finished tiles, handed to the main loop like in fractal-viewer
+struct CompletedTile {
+  int index;
+  int generation;
+  Color *pixels;
+  // Time the thread spent computing the pixels, in seconds
+  double computeTime;
+};
+std::unique_ptr<CompletionQueue<CompletedTile>> completedTiles;
+
+struct Result {
+  int threads;
+  double seconds;
+  double speedup, efficiency;
+  // Average time until the centre tile of a view is back, in seconds (what the user waits for)
+  double focusLatency;
+  // Tile times, in seconds
+  double tileMin, tileP50, tileP90, tileP99, tileMax;
+};
+
+// Hand computed pixels to the main loop (same as fractal-viewer)
+void onTileRendered(const RenderView &, const RenderTile &renderTile, const RenderStats &stats) {
+  while (!completedTiles->push({renderTile.index, renderTile.generation, renderTile.pixels, stats.seconds})) {
+    std::this_thread::yield();
+  }
+}
+
+// Start computing a tile on the pool, like fractal-viewer
+void startTile(RenderPool &renderPool, const PendingTile &pendingTile) {
+  Tile &tile = tiles[pendingTile.index];
+  if (tile.generation <= pendingTile.generation) {
+    tile.generation = pendingTile.generation;
+  }
+
+  RenderView view;
+  view.set = SET;
+  view.cx = pendingTile.cx;
+  view.cy = pendingTile.cy;
+  view.zoom = pendingTile.cz;
+  view.width = SCREEN_WIDTH;
+  view.height = SCREEN_HEIGHT;
+  view.maxIterations = pendingTile.maxIterations;
+
+  RenderTile renderTile;
+  renderTile.index = pendingTile.index;
+  renderTile.generation = pendingTile.generation;
+  renderTile.x = tile.tileX * TILE_WIDTH;
+  renderTile.y = tile.tileY * TILE_HEIGHT;
+  renderTile.width = TILE_WIDTH;
+  renderTile.height = TILE_HEIGHT;
+  renderTile.pixels = new Color[(int) (TILE_WIDTH * TILE_HEIGHT)];
+  renderPool.submit(view, renderTile, onTileRendered);
+}
+
+double getPercentile(const std::vector<double> &sorted, double percentile) {
+  if (sorted.empty()) { return 0; }
+  size_t index = (size_t) (percentile * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(index, sorted.size() - 1)];
+}
+
+// Render FRAMES views with at most maxThreads tiles in flight, driving the scheduler like the main loop of fractal-viewer
+Result runWithThreads(int maxThreads) {
+  RenderPool renderPool(maxThreads);
+  TileScheduler scheduler(TILES_X, TILES_Y);
+  scheduler.avoidDuplicates = AVOID_DUPLICATES;
+  scheduler.prioritizeFocus = PRIORITIZE_FOCUS;
+  for (Tile &tile : tiles) {
+    tile.generation = 0;
+  }
+  completedTiles = std::make_unique<CompletionQueue<CompletedTile>>(maxThreads + 1);
+
+  std::vector<double> tileTimes;
+  double focusLatency = 0;
+  const int focusIndex = TILES_Y / 2 * TILES_X + TILES_X / 2;
+  long double cx = cameraX;
+  auto start = std::chrono::steady_clock::now();
+
+  for (int generation = 0; generation < FRAMES; generation++) {
+    long double diffX = generation == 0 ? 0 : -TILE_WIDTH / zoom;
+    auto viewStart = std::chrono::steady_clock::now();
+    scheduler.scheduleView(cx, cameraY, zoom, generation, MAX_ITERATIONS, diffX, 0);
+
+    // A view is done when every tile has been handed back
+    int remaining = tiles.size();
+    while (remaining > 0) {
+      PendingTile next;
+      while (renderPool.getBusy() < renderPool.getThreadCount() && scheduler.pop(next)) {
+        // Check that the tile has not already been computed by a newer generation
+        if (next.generation - tiles[next.index].generation >= 0) {
+          startTile(renderPool, next);
+        }
+      }
+
+      // Collect the finished tiles (where fractal-viewer uploads them), the view is done once every tile of its generation is back
+      CompletedTile completed;
+      while (completedTiles->pop(completed)) {
+        tileTimes.push_back(completed.computeTime);
+        delete[] completed.pixels;
+        if (completed.generation == generation) {
+          remaining--;
+          if (completed.index == focusIndex) {
+            focusLatency += std::chrono::duration<double>(std::chrono::steady_clock::now() - viewStart).count();
+          }
+        }
+      }
+
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+
+    if (PAN) { cx += TILE_WIDTH / zoom; }
+  }
+
+  // Tiles of older generations still being computed
+  renderPool.wait();
+  CompletedTile completed;
+  while (completedTiles->pop(completed)) {
+    delete[] completed.pixels;
+  }
+
+  Result result;
+  result.threads = maxThreads;
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  result.focusLatency = focusLatency / FRAMES;
+  std::sort(tileTimes.begin(), tileTimes.end());
+  result.tileMin = getPercentile(tileTimes, 0);
+  result.tileP50 = getPercentile(tileTimes, 0.5);
+  result.tileP90 = getPercentile(tileTimes, 0.9);
+  result.tileP99 = getPercentile(tileTimes, 0.99);
+  result.tileMax = getPercentile(tileTimes, 1);
+  return result;
+}
+
+bool writeJson(const std::vector<Result> &results) {
+  std::ofstream file(JSON_PATH);
+  if (!file.is_open()) { return false; }
+
+  file << "{\n";
+  file << "  \"benchmark\": \"render-bench\",\n";
+  file << "  \"width\": " << SCREEN_WIDTH << ",\n  \"height\": " << SCREEN_HEIGHT << ",\n";
+  file << "  \"tilesX\": " << TILES_X << ",\n  \"tilesY\": " << TILES_Y << ",\n";
+  file << "  \"set\": \"" << getSetName(SET) << "\",\n  \"maxIterations\": " << MAX_ITERATIONS << ",\n";
+  file << "  \"frames\": " << FRAMES << ",\n  \"pan\": " << (PAN ? "true" : "false") << ",\n";
+  file << "  \"prioritizeFocus\": " << (PRIORITIZE_FOCUS ? "true" : "false") << ",\n";
+  file << "  \"results\": [\n";
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result &result = results[i];
+    file << "    {\"threads\": " << result.threads << ", \"seconds\": " << result.seconds << ", ";
+    file << "\"speedup\": " << result.speedup << ", \"efficiency\": " << result.efficiency << ", ";
+    file << "\"focusSeconds\": " << result.focusLatency << ", ";
+    file << "\"tileSeconds\": {\"min\": " << result.tileMin << ", \"p50\": " << result.tileP50 << ", \"p90\": " << result.tileP90;
+    file << ", \"p99\": " << result.tileP99 << ", \"max\": " << result.tileMax << "}}";
+    file << (i + 1 < results.size() ? ",\n" : "\n");
+  }
+  file << "  ]\n}\n";
+  return file.good();
+}
+
+
+// Main function
+int main(int argc, char *argv[]) {
+  // Replace constants by the ones given in the flags (if present)
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--width") {
+      SCREEN_WIDTH = std::stoi(argv[++i]);
+    } else if (arg == "--height") {
+      SCREEN_HEIGHT = std::stoi(argv[++i]);
+    } else if (arg == "--tiles") {
+      // Tile grid, as columns x rows (e.g. 16x9)
+      if (sscanf(argv[++i], "%dx%d", &TILES_X, &TILES_Y) != 2 || TILES_X < 1 || TILES_Y < 1) {
+        std::cerr << "Invalid tile grid " << argv[i] << ", expected columns x rows (e.g. 16x9)" << std::endl;
+        return 1;
+      }
+    } else if (arg == "--set") {
+      SET = getSetFromName(argv[++i]);
+      if (SET < 0) {
+        std::cerr << "Unknown set " << argv[i] << std::endl;
+        return 1;
+      }
+    } else if (arg == "--it") {
+      MAX_ITERATIONS = std::stoi(argv[++i]);
+    } else if (arg == "--frames") {
+      FRAMES = std::max(1, std::stoi(argv[++i]));
+    } else if (arg == "--pan") {
+      PAN = true;
+    } else if (arg == "--no-avoid-duplicates") {
+      AVOID_DUPLICATES = false;
+    } else if (arg == "--priority") {
+      PRIORITIZE_FOCUS = true;
+    } else if (arg == "--threads") {
+      // Comma separated list of thread counts (e.g. 1,2,4,8)
+      std::stringstream list(argv[++i]);
+      std::string count;
+      while (std::getline(list, count, ',')) {
+        THREAD_COUNTS.push_back(std::stoi(count));
+        if (THREAD_COUNTS.back() < 1) {
+          std::cerr << "Invalid thread count " << count << std::endl;
+          return 1;
+        }
+      }
+    } else if (arg == "--zoom") {
+      zoom = std::stold(argv[++i]);
+    } else if (arg == "--x") {
+      cameraX = std::stold(argv[++i]);
+    } else if (arg == "--y") {
+      cameraY = std::stold(argv[++i]);
+    } else if (arg == "--json") {
+      JSON_PATH = argv[++i];
+    }
+  }
+
+  if (THREAD_COUNTS.empty()) {
+    int cores = std::max(1, (int) std::thread::hardware_concurrency());
+    for (int count = 1; count < cores; count *= 2) {
+      THREAD_COUNTS.push_back(count);
+    }
+    THREAD_COUNTS.push_back(cores);
+  }
+
+  // Compute values based of the given flags
+  TILE_WIDTH = SCREEN_WIDTH / TILES_X;
+  TILE_HEIGHT = SCREEN_HEIGHT / TILES_Y;
+  HALF_SCREEN_WIDTH = SCREEN_WIDTH / 2.0;
+  HALF_SCREEN_HEIGHT = SCREEN_HEIGHT / 2.0;
+  tiles = std::vector<Tile>(TILES_X * TILES_Y);
+  for (int y = 0; y < TILES_Y; y++) {
+    for (int x = 0; x < TILES_X; x++) {
+      tiles[y * TILES_X + x].tileX = x;
+      tiles[y * TILES_X + x].tileY = y;
+    }
+  }
+
+  printf("%s, %dx%d in %dx%d tiles, %d iterations, %d frame(s)%s%s\n", getSetName(SET), SCREEN_WIDTH, SCREEN_HEIGHT, TILES_X, TILES_Y,
+         MAX_ITERATIONS, FRAMES, PAN ? " panning" : "", PRIORITIZE_FOCUS ? ", centre first" : "");
+  printf("%8s %10s %8s %10s %10s %10s %10s %10s %10s\n", "threads", "wall ms", "speedup", "efficiency", "centre ms", "tile p50", "tile p90", "tile p99",
+         "tile max");
+
+  // Speedup and efficiency are relative to the first thread count measured (normally 1)
+  std::vector<Result> results;
+  for (int threads : THREAD_COUNTS) {
+    Result result = runWithThreads(threads);
+    const Result &base = results.empty() ? result : results.front();
+    result.speedup = base.seconds / result.seconds;
+    result.efficiency = result.speedup * base.threads / threads;
+    results.push_back(result);
+
+    printf("%8d %10.1f %8.2f %9.0f%% %10.2f %10.2f %10.2f %10.2f %10.2f\n", threads, result.seconds * 1000, result.speedup, result.efficiency * 100,
+           result.focusLatency * 1000, result.tileP50 * 1000, result.tileP90 * 1000, result.tileP99 * 1000, result.tileMax * 1000);
+    fflush(stdout);
+  }
+
+  if (!JSON_PATH.empty()) {
+    if (!writeJson(results)) {
+      std::cerr << "Could not write " << JSON_PATH << std::endl;
+      return 1;
+    }
+    std::cout << "Results written to " << JSON_PATH << std::endl;
+  }
+  return 0;
+}
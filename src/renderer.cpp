@@ -0,0 +1,482 @@
+#include "renderer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include "histogram.hpp"
+#include "trace.hpp"
+
+// Spacing of the pixels computed to check a uniform area of the previous view
+static const int VERIFY_SPACING = 4;
+// Spacing of the pixels computed first with distance estimation, their discs cover most of the empty areas
+static const int DISTANCE_SPACING = 8;
+
+static const char *COLORING_NAMES[COLORING_COUNT] = {"iterations", "distance", "histogram"};
+
+const char *getColoringName(int coloring) {
+  return coloring >= 0 && coloring < COLORING_COUNT ? COLORING_NAMES[coloring] : "unknown";
+}
+
+int getColoringFromName(const std::string &name) {
+  for (int coloring = 0; coloring < COLORING_COUNT; coloring++) {
+    if (name == COLORING_NAMES[coloring]) { return coloring; }
+  }
+  return -1;
+}
+
+static const char *INTERIOR_NAMES[INTERIOR_COUNT] = {"off", "detect", "period"};
+
+const char *getInteriorName(int interior) {
+  return interior >= 0 && interior < INTERIOR_COUNT ? INTERIOR_NAMES[interior] : "unknown";
+}
+
+int getInteriorFromName(const std::string &name) {
+  for (int interior = 0; interior < INTERIOR_COUNT; interior++) {
+    if (name == INTERIOR_NAMES[interior]) { return interior; }
+  }
+  return -1;
+}
+
+int getPreferredLanes(int set, int precision) {
+  // Lyapunov points all run the same sequence, and the stable ones every iteration, so its lanes never wait for each other
+  // (not in long double, it has no vector registers)
+  return set == SET_LYAPUNOV && precision != PRECISION_LONG_DOUBLE ? 4 : 1;
+}
+
+static Color getColor(const RenderView &view, const PointSample &sample) {
+  if (view.interior == INTERIOR_PERIOD && !sample.escaped && sample.period > 0) { return getColorFromInterior(sample); }
+  if (view.coloring == COLORING_DISTANCE && hasDistanceEstimation(view.set)) { return getColorFromDistance(sample, view.zoom); }
+  if (view.coloring == COLORING_HISTOGRAM && view.set != SET_LYAPUNOV && sample.escaped) {
+    return view.histogram != nullptr ? view.histogram->getColor(sample, view.maxIterations) : getColorFromLevel(sample.n / view.maxIterations);
+  }
+  return getColorFromSample(view.set, sample, view.maxIterations);
+}
+
+// Whether two samples are drawn alike : same iterations outside the set, and inside same cycle if it is colored
+// (interior detection stops the points inside after any number of iterations)
+static bool sameBand(const RenderView &view, const PointSample &a, const PointSample &b) {
+  if (a.escaped != b.escaped) { return false; }
+  return a.escaped ? a.n == b.n : view.interior != INTERIOR_PERIOD || a.period == b.period;
+}
+
+// Points of the view, with the kernel of its coloring
+template <typename Real>
+static void sampleBatch(const RenderView &view, const Real *a, const Real *b, PointSample *samples, int count) {
+  if (view.coloring == COLORING_DISTANCE && hasDistanceEstimation(view.set)) {
+    for (int p = 0; p < count; p++) { samples[p] = samplePointDistance(view.set, a[p], b[p], view.maxIterations, view.parameters); }
+  } else if (view.interior != INTERIOR_OFF && hasInteriorDetection(view.set)) {
+    for (int p = 0; p < count; p++) { samples[p] = samplePointInterior(view.set, a[p], b[p], view.maxIterations, view.parameters); }
+  } else {
+    samplePoints(view.set, a, b, samples, count, view.maxIterations, view.lanes, view.parameters);
+  }
+}
+
+// A row of the tile, with the batched kernels
+template <typename Real>
+static void renderRow(const RenderView &view, const RenderTile &tile, int row, PointSample *samples) {
+  thread_local std::vector<Real> a, b;
+  a.resize(tile.width);
+  b.resize(tile.width);
+
+  long double offsetY = (tile.y + row - view.height / 2.0L) / view.zoom;
+  for (int i = 0; i < tile.width; i++) {
+    long double offsetX = (tile.x + i - view.width / 2.0L) / view.zoom;
+    a[i] = (Real) (view.cx + offsetX);
+    b[i] = (Real) (view.cy + offsetY);
+  }
+  sampleBatch(view, a.data(), b.data(), samples, tile.width);
+}
+
+// A row of the tile, as offsets from the reference orbit
+static void renderRowPerturbed(const RenderView &view, const RenderTile &tile, int row, PointSample *samples) {
+  const ReferenceOrbit &orbit = *view.orbit;
+  double dy = (double) ((tile.y + row - view.height / 2.0L) / view.zoom + (view.cy - orbit.getCenterY()));
+  for (int i = 0; i < tile.width; i++) {
+    double dx = (double) ((tile.x + i - view.width / 2.0L) / view.zoom + (view.cx - orbit.getCenterX()));
+    samples[i] = samplePoint_MandelbrotPerturbed(orbit, dx, dy, view.maxIterations);
+  }
+}
+
+// Points of the image (in pixels from its top left corner, between pixels allowed), with the batched kernels
+template <typename Real>
+static void samplePositions(const RenderView &view, const std::vector<long double> &x, const std::vector<long double> &y, PointSample *samples) {
+  thread_local std::vector<Real> a, b;
+  a.resize(x.size());
+  b.resize(x.size());
+  for (size_t p = 0; p < x.size(); p++) {
+    a[p] = (Real) (view.cx + (x[p] - view.width / 2.0L) / view.zoom);
+    b[p] = (Real) (view.cy + (y[p] - view.height / 2.0L) / view.zoom);
+  }
+  sampleBatch(view, a.data(), b.data(), samples, (int) x.size());
+}
+
+static void samplePositions(const RenderView &view, const std::vector<long double> &x, const std::vector<long double> &y, PointSample *samples) {
+  if (x.empty()) { return; }
+  if (view.orbit != nullptr && view.set == SET_MANDELBROT && view.coloring != COLORING_DISTANCE) {
+    // Same as renderRowPerturbed
+    const ReferenceOrbit &orbit = *view.orbit;
+    for (size_t p = 0; p < x.size(); p++) {
+      double dx = (double) ((x[p] - view.width / 2.0L) / view.zoom + (view.cx - orbit.getCenterX()));
+      double dy = (double) ((y[p] - view.height / 2.0L) / view.zoom + (view.cy - orbit.getCenterY()));
+      samples[p] = samplePoint_MandelbrotPerturbed(orbit, dx, dy, view.maxIterations);
+    }
+    return;
+  }
+  switch (view.precision) {
+    case PRECISION_FLOAT: samplePositions<float>(view, x, y, samples); break;
+    case PRECISION_DOUBLE: samplePositions<double>(view, x, y, samples); break;
+    default: samplePositions<long double>(view, x, y, samples); break;
+  }
+}
+
+// Some pixels of the tile (indices in the tile)
+static void renderPixels(const RenderView &view, const RenderTile &tile, const std::vector<int> &pixels, PointSample *samples) {
+  thread_local std::vector<long double> x, y;
+  thread_local std::vector<PointSample> computed;
+  x.resize(pixels.size());
+  y.resize(pixels.size());
+  computed.resize(pixels.size());
+  for (size_t p = 0; p < pixels.size(); p++) {
+    x[p] = tile.x + pixels[p] % tile.width;
+    y[p] = tile.y + pixels[p] / tile.width;
+  }
+  samplePositions(view, x, y, computed.data());
+  for (size_t p = 0; p < pixels.size(); p++) {
+    samples[pixels[p]] = computed[p];
+  }
+}
+
+bool reprojectTile(const SampleFrame &previous, const RenderView &view, const RenderTile &tile, PointSample *samples, unsigned char *uniform) {
+  const RenderView &old = previous.view;
+  if (old.set != view.set || old.parameters != view.parameters || old.maxIterations != view.maxIterations || old.zoom > view.zoom || view.set == SET_LYAPUNOV) { return false; }
+  // Distance estimation skips the empty areas on its own
+  if (old.coloring != view.coloring || old.interior != view.interior || view.coloring == COLORING_DISTANCE) { return false; }
+  if ((int) previous.samples.size() != old.width * old.height) { return false; }
+
+  auto getOld = [&previous, &old](int x, int y) -> const PointSample * {
+    if (x < 0 || y < 0 || x >= old.width || y >= old.height) { return nullptr; }
+    const PointSample &sample = previous.samples[y * old.width + x];
+    return sample.n < 0 ? nullptr : &sample;
+  };
+
+  // Position of the pixel in the older view : (new position - new center) / new zoom = (old position - old center) / old zoom, around the centers
+  long double scale = old.zoom / view.zoom;
+  long double offsetX = (view.cx - old.cx) * old.zoom + old.width / 2.0L;
+  long double offsetY = (view.cy - old.cy) * old.zoom + old.height / 2.0L;
+  for (int j = 0; j < tile.height; j++) {
+    int y = (int) std::floor((tile.y + j + 0.5L - view.height / 2.0L) * scale + offsetY);
+    for (int i = 0; i < tile.width; i++) {
+      int x = (int) std::floor((tile.x + i + 0.5L - view.width / 2.0L) * scale + offsetX);
+      const PointSample *nearest = getOld(x, y);
+      PointSample &sample = samples[j * tile.width + i];
+      sample = nearest != nullptr ? *nearest : PointSample();
+      if (uniform == nullptr) { continue; }
+
+      bool same = nearest != nullptr;
+      for (int dy = -1; dy <= 1 && same; dy++) {
+        for (int dx = -1; dx <= 1 && same; dx++) {
+          const PointSample *neighbour = getOld(x + dx, y + dy);
+          same = neighbour != nullptr && sameBand(view, *neighbour, *nearest);
+        }
+      }
+      uniform[j * tile.width + i] = same;
+    }
+  }
+  return true;
+}
+
+// Compute the pixels outside the uniform areas and a coarse grid of the others, then the uniform pixels whose grid cell doesn't agree with the prediction
+// The accepted pixels keep the predicted iterations, with the coloring value interpolated between the corners of their cell
+static int refineTile(const RenderView &view, const RenderTile &tile, PointSample *samples, const unsigned char *uniform, long long &iterationsSkipped) {
+  auto onGrid = [&tile](int i, int j) {
+    return (i % VERIFY_SPACING == 0 || i == tile.width - 1) && (j % VERIFY_SPACING == 0 || j == tile.height - 1);
+  };
+
+  thread_local std::vector<int> pixels;
+  pixels.clear();
+  for (int j = 0; j < tile.height; j++) {
+    for (int i = 0; i < tile.width; i++) {
+      if (!uniform[j * tile.width + i] || onGrid(i, j)) { pixels.push_back(j * tile.width + i); }
+    }
+  }
+  renderPixels(view, tile, pixels, samples);
+
+  pixels.clear();
+  int reprojected = 0;
+  for (int j = 0; j < tile.height; j++) {
+    int j0 = j / VERIFY_SPACING * VERIFY_SPACING;
+    int j1 = std::min(j0 + VERIFY_SPACING, tile.height - 1);
+    for (int i = 0; i < tile.width; i++) {
+      int index = j * tile.width + i;
+      if (!uniform[index] || onGrid(i, j)) { continue; }
+
+      int i0 = i / VERIFY_SPACING * VERIFY_SPACING;
+      int i1 = std::min(i0 + VERIFY_SPACING, tile.width - 1);
+      PointSample &sample = samples[index];
+      const PointSample *corners[4] = {&samples[j0 * tile.width + i0], &samples[j0 * tile.width + i1], &samples[j1 * tile.width + i0],
+                                       &samples[j1 * tile.width + i1]};
+      bool agrees = true;
+      for (const PointSample *corner : corners) {
+        agrees = agrees && sameBand(view, *corner, sample);
+      }
+      if (!agrees) {
+        pixels.push_back(index);
+        continue;
+      }
+
+      float fx = (float) (i - i0) / (i1 - i0);
+      float fy = j1 == j0 ? 0 : (float) (j - j0) / (j1 - j0);
+      float top = corners[0]->value + (corners[1]->value - corners[0]->value) * fx;
+      float bottom = corners[2]->value + (corners[3]->value - corners[2]->value) * fx;
+      sample.value = top + (bottom - top) * fy;
+      iterationsSkipped += (long long) sample.n;
+      reprojected++;
+    }
+  }
+  renderPixels(view, tile, pixels, samples);
+  return reprojected;
+}
+
+// Pixels whose iterations differ from a neighbour (the edges of the color bands and of the set) get view.aaSamples more samples, averaged
+// The other pixels don't alias, so this looks close to supersampling everything for a fraction of the cost
+static int antialiasTile(const RenderView &view, const RenderTile &tile, const PointSample *samples, Color *pixels, int stride, long long &iterations) {
+  auto differs = [&view](const PointSample &a, const PointSample &b) { return !sameBand(view, a, b); };
+  thread_local std::vector<int> edges;
+  edges.clear();
+  for (int j = 0; j < tile.height; j++) {
+    for (int i = 0; i < tile.width; i++) {
+      int index = j * tile.width + i;
+      const PointSample &sample = samples[index];
+      if ((i > 0 && differs(sample, samples[index - 1])) || (i + 1 < tile.width && differs(sample, samples[index + 1])) ||
+          (j > 0 && differs(sample, samples[index - tile.width])) || (j + 1 < tile.height && differs(sample, samples[index + tile.width]))) {
+        edges.push_back(index);
+      }
+    }
+  }
+  if (edges.empty()) { return 0; }
+
+  // R2 sequence inside the pixel, shifted by a hash of its position so neighbours don't share a pattern (the same in every frame)
+  int count = view.aaSamples;
+  thread_local std::vector<long double> x, y;
+  thread_local std::vector<PointSample> subsamples;
+  x.resize(edges.size() * count);
+  y.resize(edges.size() * count);
+  subsamples.resize(edges.size() * count);
+  for (size_t e = 0; e < edges.size(); e++) {
+    int i = edges[e] % tile.width, j = edges[e] / tile.width;
+    unsigned int hash = (unsigned int) (tile.x + i) * 73856093u ^ (unsigned int) (tile.y + j) * 19349663u;
+    float shiftX = (hash & 0xffff) / 65536.0f, shiftY = (hash >> 16) / 65536.0f;
+    for (int k = 0; k < count; k++) {
+      float fx = shiftX + 0.7548776662f * (k + 1), fy = shiftY + 0.5698402910f * (k + 1);
+      x[e * count + k] = tile.x + i + (fx - std::floor(fx)) - 0.5L;
+      y[e * count + k] = tile.y + j + (fy - std::floor(fy)) - 0.5L;
+    }
+  }
+  samplePositions(view, x, y, subsamples.data());
+
+  for (size_t e = 0; e < edges.size(); e++) {
+    int i = edges[e] % tile.width, j = edges[e] / tile.width;
+    Color &pixel = pixels[(size_t) j * stride + i];
+    int r = pixel.r, g = pixel.g, b = pixel.b, a = pixel.a;
+    for (int k = 0; k < count; k++) {
+      const PointSample &subsample = subsamples[e * count + k];
+      Color color = getColor(view, subsample);
+      r += color.r;
+      g += color.g;
+      b += color.b;
+      a += color.a;
+      iterations += (long long) subsample.n;
+    }
+    int total = count + 1;
+    pixel = {(unsigned char) ((r + total / 2) / total), (unsigned char) ((g + total / 2) / total), (unsigned char) ((b + total / 2) / total),
+             (unsigned char) ((a + total / 2) / total)};
+  }
+  return (int) edges.size();
+}
+
+// Distance estimation : a grid of pixels first, then the others row by row, skipping the pixels in the discs the computed ones proved empty
+// Mandelbrot is at least the estimated distance away from an escaped pixel, so a disc of that radius (minus the fade) is drawn white anyway
+// The other sets are not always connected and the bound doesn't hold for them, they only get half of it
+static int renderTileDistance(const RenderView &view, const RenderTile &tile, PointSample *samples, long long &iterationsSkipped) {
+  thread_local std::vector<unsigned char> known;
+  thread_local std::vector<int> pixels;
+  known.assign(tile.width * tile.height, false);
+  float safety = view.set == SET_MANDELBROT || view.set == SET_MANDELBROT_LIGHT_EFFECT ? 1 : 0.5f;
+  int skipped = 0;
+
+  auto clearDisc = [&](int index) {
+    const PointSample &center = samples[index];
+    float radius = safety * center.distance * (float) view.zoom - DISTANCE_FADE;
+    if (!center.escaped || radius < 1) { return; }
+    // Far from the set the bound grows without limit (up to inf), nothing past the tile diagonal is needed
+    radius = std::min(radius, std::hypot((float) tile.width, (float) tile.height));
+
+    // Every pixel of the disc is at least DISTANCE_FADE pixels from the set
+    PointSample far = center;
+    far.distance = center.distance - radius / (float) view.zoom;
+    int ci = index % tile.width, cj = index / tile.width;
+    int r = (int) radius;
+    for (int j = std::max(0, cj - r); j <= std::min(tile.height - 1, cj + r); j++) {
+      int half = (int) std::sqrt(radius * radius - (float) ((j - cj) * (j - cj)));
+      for (int i = std::max(0, ci - half); i <= std::min(tile.width - 1, ci + half); i++) {
+        int k = j * tile.width + i;
+        if (known[k]) { continue; }
+        known[k] = true;
+        samples[k] = far;
+        iterationsSkipped += (long long) far.n;
+        skipped++;
+      }
+    }
+  };
+  auto renderKnown = [&]() {
+    renderPixels(view, tile, pixels, samples);
+    for (int index : pixels) { known[index] = true; }
+    for (int index : pixels) { clearDisc(index); }
+  };
+
+  // One at a time, the discs of the first ones often cover the next ones
+  for (int j = 0; j < tile.height; j += DISTANCE_SPACING) {
+    for (int i = 0; i < tile.width; i += DISTANCE_SPACING) {
+      if (known[j * tile.width + i]) { continue; }
+      pixels.assign(1, j * tile.width + i);
+      renderKnown();
+    }
+  }
+
+  for (int j = 0; j < tile.height; j++) {
+    pixels.clear();
+    for (int i = 0; i < tile.width; i++) {
+      if (!known[j * tile.width + i]) { pixels.push_back(j * tile.width + i); }
+    }
+    renderKnown();
+  }
+  return skipped;
+}
+
+RenderStats renderTile(const RenderView &view, const RenderTile &tile) {
+  TraceScope trace("compute", tile.index, tile.generation);
+  auto start = std::chrono::steady_clock::now();
+
+  // Samples go to the caller if it wants them (and they are contiguous), else to a scratch buffer
+  thread_local std::vector<PointSample> scratch;
+  int sampleStride = tile.sampleStride > 0 ? tile.sampleStride : tile.width;
+  PointSample *samples = sampleStride == tile.width ? tile.samples : nullptr;
+  if (samples == nullptr) {
+    scratch.resize(tile.width * tile.height);
+    samples = scratch.data();
+  }
+
+  RenderStats stats;
+  thread_local std::vector<unsigned char> uniform;
+  if (tile.previous != nullptr) { uniform.resize(tile.width * tile.height); }
+  long long iterationsSkipped = 0;
+  bool perturbed = view.orbit != nullptr && view.set == SET_MANDELBROT;
+  if (view.coloring == COLORING_DISTANCE && hasDistanceEstimation(view.set)) {
+    stats.pixelsSkipped = renderTileDistance(view, tile, samples, iterationsSkipped);
+  } else if (tile.previous != nullptr && reprojectTile(*tile.previous, view, tile, samples, uniform.data())) {
+    stats.pixelsReprojected = refineTile(view, tile, samples, uniform.data(), iterationsSkipped);
+  } else {
+    for (int j = 0; j < tile.height; j++) {
+      PointSample *row = samples + j * tile.width;
+      if (perturbed) {
+        renderRowPerturbed(view, tile, j, row);
+        continue;
+      }
+      switch (view.precision) {
+        case PRECISION_FLOAT: renderRow<float>(view, tile, j, row); break;
+        case PRECISION_DOUBLE: renderRow<double>(view, tile, j, row); break;
+        default: renderRow<long double>(view, tile, j, row); break;
+      }
+    }
+  }
+
+  if (tile.samples != nullptr && samples != tile.samples) {
+    for (int j = 0; j < tile.height; j++) {
+      std::copy(samples + j * tile.width, samples + (j + 1) * tile.width, tile.samples + (size_t) j * sampleStride);
+    }
+  }
+
+  int stride = tile.stride > 0 ? tile.stride : tile.width;
+  for (int j = 0; j < tile.height; j++) {
+    const PointSample *row = samples + j * tile.width;
+    Color *pixels = tile.pixels != nullptr ? tile.pixels + (size_t) j * stride : nullptr;
+    for (int i = 0; i < tile.width; i++) {
+      stats.iterations += row[i].n;
+      if (pixels != nullptr) {
+        pixels[i] = getColor(view, row[i]);
+      }
+    }
+  }
+  stats.iterations -= iterationsSkipped;
+  if (view.aaSamples > 0 && view.coloring != COLORING_HISTOGRAM && tile.pixels != nullptr) {
+    stats.pixelsAntialiased = antialiasTile(view, tile, samples, tile.pixels, stride, stats.iterations);
+  }
+  stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return stats;
+}
+
+void recolorTile(const RenderView &view, const RenderTile &tile) {
+  TraceScope trace("recolor", tile.index, tile.generation);
+  int stride = tile.stride > 0 ? tile.stride : tile.width;
+  int sampleStride = tile.sampleStride > 0 ? tile.sampleStride : tile.width;
+  for (int j = 0; j < tile.height; j++) {
+    const PointSample *samples = tile.samples + (size_t) j * sampleStride;
+    Color *pixels = tile.pixels + (size_t) j * stride;
+    for (int i = 0; i < tile.width; i++) {
+      pixels[i] = getColor(view, samples[i]);
+    }
+  }
+}
+
+
+RenderPool::RenderPool(int threadCount) {
+  for (int i = 0; i < std::max(1, threadCount); i++) {
+    workers.emplace_back(&RenderPool::work, this, i);
+  }
+}
+
+RenderPool::~RenderPool() {
+  {
+    std::lock_guard<std::mutex> lock(jobsMutex);
+    stopping = true;
+  }
+  jobsChanged.notify_all();
+  for (auto &worker : workers) { worker.join(); }
+}
+
+void RenderPool::submit(const RenderView &view, const RenderTile &tile, RenderCallback onDone) {
+  busy.fetch_add(1, std::memory_order_relaxed);
+  {
+    std::lock_guard<std::mutex> lock(jobsMutex);
+    jobs.push_back({view, tile, std::move(onDone)});
+  }
+  jobsChanged.notify_one();
+}
+
+void RenderPool::wait() {
+  std::unique_lock<std::mutex> lock(jobsMutex);
+  tilesDone.wait(lock, [this]() { return busy.load(std::memory_order_acquire) == 0; });
+}
+
+void RenderPool::work(int worker) {
+  while (true) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(jobsMutex);
+      jobsChanged.wait(lock, [this]() { return stopping || !jobs.empty(); });
+      // Only stop once every tile is done
+      if (jobs.empty()) { return; }
+      job = std::move(jobs.front());
+      jobs.pop_front();
+    }
+
+    RenderStats stats = renderTile(job.view, job.tile);
+    stats.worker = worker;
+    if (job.onDone) { job.onDone(job.view, job.tile, stats); }
+
+    // Wake up wait() when the last tile is done
+    if (busy.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      std::lock_guard<std::mutex> lock(jobsMutex);
+      tilesDone.notify_all();
+    }
+  }
+}
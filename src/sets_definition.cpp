@@ -1,26 +1,39 @@
 #include "sets_definition.hpp"
 #include <iostream>
 #include <cmath>
+#include <cctype>
+#include <limits>
+#include <sstream>
+#include <type_traits>
+#include <algorithm>
 
 
 // Mandelbrot
 static const long double pisqrtpi = PI * std::sqrt(PI);
 static const long double pisqrt2  = PI * std::sqrt(2);
-Color getColorFromPoint_Mandelbrot(long double a, long double b, float maxIterations) {
-    long double ca = a;
-    long double cb = b;
+template <typename Real>
+PointSample samplePoint_Mandelbrot(Real a, Real b, float maxIterations) {
+    Real ca = a;
+    Real cb = b;
 
     int n;
-    long double aa, bb;
+    Real aa;
     for (n = 0; (a * a + b * b <= 16) && (n < maxIterations); n++) {
         aa = a * a - b * b + ca;
-        b  = 2.0L * a * b + cb;
+        b  = 2 * a * b + cb;
         a  = aa;
     }
 
-    // Coloring
+    PointSample sample;
+    sample.n = n;
+    sample.escaped = n < maxIterations;
+    return sample;
+}
+
+Color getColorFromSample_Mandelbrot(const PointSample &sample, float) {
+    int n = sample.n;
     Color color = BLACK;
-    if (n < maxIterations) {
+    if (sample.escaped) {
         color.a = 255;
         color.r = ((int)(n * PI))       % 255;
         color.g = ((int)(n * pisqrtpi)) % 255;
@@ -32,42 +45,68 @@ Color getColorFromPoint_Mandelbrot(long double a, long double b, float maxIterat
 
 // Mandelbrot "light" effect
 static const long double PI2 = PI / 180.0L; // degrees → radians
-Color getColorFromPoint_Mandelbrot_LightEffect(long double a, long double b, float maxIterations) {
+// Shading of an escaped point, from its last z and its derivative over c
+template <typename Real>
+static float getLightEffectValue(Real z_re, Real z_im, Real der_re, Real der_im) {
     // Parameters for lighting
     const long double h2 = 1.5L;       // height of light source
     const long double angle = 45.0L;   // incoming light direction (degrees)
-    const long double R = 100.0L;      // escape radius
 
     // Convert angle to unit vector v = exp(i * angle)
     long double v_re = cosl(angle * PI2);
     long double v_im = sinl(angle * PI2);
 
+    // Compute u = z/der
+    long double denom = der_re * der_re + der_im * der_im;
+    if (denom == 0.0L) denom = 1e-16L;
+    long double u_re = (z_re * der_re + z_im * der_im) / denom;
+    long double u_im = (z_im * der_re - z_re * der_im) / denom;
+
+    // Normalize u
+    long double norm = sqrtl(u_re * u_re + u_im * u_im);
+    if (norm == 0.0L) norm = 1e-16L;
+    u_re /= norm;
+    u_im /= norm;
+
+    // Dot product with light direction (u.re, u.im, 1) · (v.re, v.im, h2)
+    long double t = u_re * v_re + u_im * v_im + h2;
+    t /= (1.0L + h2);  // rescale
+
+    if (t < 0.0L) t = 0.0L;
+    if (t > 1.0L) t = 1.0L;
+    return t;
+}
+
+template <typename Real>
+PointSample samplePoint_Mandelbrot_LightEffect(Real a, Real b, float maxIterations) {
+    const long double R = 100.0L;      // escape radius
+
     // Start iteration
-    long double ca = a;
-    long double cb = b;
+    Real ca = a;
+    Real cb = b;
 
-    long double z_re = ca;
-    long double z_im = cb;
+    Real z_re = ca;
+    Real z_im = cb;
 
-    long double der_re = 1.0L;
-    long double der_im = 0.0L;
+    Real der_re = 1;
+    Real der_im = 0;
 
     int n;
     bool escaped = false;
 
     for (n = 0; n < maxIterations; n++) {
-        if (z_re * z_re + z_im * z_im > R * R) {
+        if (z_re * z_re + z_im * z_im > (Real) (R * R)) {
             escaped = true;
             break;
         }
 
         // z = z^2 + c
-        long double new_z_re = z_re * z_re - z_im * z_im + ca;
-        long double new_z_im = 2.0L * z_re * z_im + cb;
+        Real new_z_re = z_re * z_re - z_im * z_im + ca;
+        Real new_z_im = 2 * z_re * z_im + cb;
 
         // der = der * 2z + 1
-        long double new_der_re = der_re * (2.0L * z_re) - der_im * (2.0L * z_im) + 1.0L;
-        long double new_der_im = der_re * (2.0L * z_im) + der_im * (2.0L * z_re);
+        Real new_der_re = der_re * (2 * z_re) - der_im * (2 * z_im) + 1;
+        Real new_der_im = der_re * (2 * z_im) + der_im * (2 * z_re);
 
         z_re = new_z_re;
         z_im = new_z_im;
@@ -76,42 +115,26 @@ Color getColorFromPoint_Mandelbrot_LightEffect(long double a, long double b, flo
         der_im = new_der_im;
     }
 
-    Color color = BLACK;
-    if (!escaped) {
-        // Did not escape
-        color = BLACK; // Inside set
-    } else {
-        // Compute u = z/der
-        long double denom = der_re * der_re + der_im * der_im;
-        if (denom == 0.0L) denom = 1e-16L;
-        long double u_re = (z_re * der_re + z_im * der_im) / denom;
-        long double u_im = (z_im * der_re - z_re * der_im) / denom;
-
-        // Normalize u
-        long double norm = sqrtl(u_re * u_re + u_im * u_im);
-        if (norm == 0.0L) norm = 1e-16L;
-        u_re /= norm;
-        u_im /= norm;
-
-        // Dot product with light direction (u.re, u.im, 1) · (v.re, v.im, h2)
-        long double t = u_re * v_re + u_im * v_im + h2;
-        t /= (1.0L + h2);  // rescale
-
-        if (t < 0.0L) t = 0.0L;
-        if (t > 1.0L) t = 1.0L;
-
-        // Linear interpolation black→white
-        unsigned char shade = (unsigned char)(t * 255.0L);
-        color = {shade, shade, shade, 255};
+    PointSample sample;
+    sample.n = n;
+    sample.escaped = escaped;
+    if (escaped) {
+        sample.value = getLightEffectValue<Real>(z_re, z_im, der_re, der_im);
     }
 
-    return color;
+    return sample;
+}
+
+Color getColorFromSample_Mandelbrot_LightEffect(const PointSample &sample, float) {
+    if (!sample.escaped) { return BLACK; } // Inside set
+
+    // Linear interpolation black→white
+    unsigned char shade = (unsigned char)(sample.value * 255.0f);
+    return Color{shade, shade, shade, 255};
 }
 
 
 // Julia
-const long double julia_ca = -0.7;    // Real part of c
-const long double julia_cb = 0.27015; // Imaginary part of c
 Color HSVtoRGB(float h, float s, float v) {
   float r, g, b;
 
@@ -147,7 +170,7 @@ Color HSVtoRGB(float h, float s, float v) {
         g = p;
         b = v;
         break;
-    case 5:
+    default: // 5
         r = v;
         g = p;
         b = q;
@@ -160,23 +183,36 @@ Color HSVtoRGB(float h, float s, float v) {
       (unsigned char)(b * 255),
       255};
 }
-Color getColorFromPoint_Julia(long double a, long double b, float maxIterations) {
+template <typename Real>
+PointSample samplePoint_Julia(Real a, Real b, float maxIterations, const SetParameters &parameters) {
+  const Real ca = (Real) parameters.juliaRe, cb = (Real) parameters.juliaIm;
   int n = 0;
-  long double aa, bb;
+  Real aa, bb;
 
   for (; n < maxIterations; ++n) {
-    if ((a * a + b * b) > 4.0) { break; }
-    aa = a * a - b * b + julia_ca;
-    bb = 2.0 * a * b + julia_cb;
+    if ((a * a + b * b) > 4) { break; }
+    aa = a * a - b * b + ca;
+    bb = 2 * a * b + cb;
     a = aa;
     b = bb;
   }
 
-  if (n == maxIterations) { return BLACK; }
+  PointSample sample;
+  sample.n = n;
+  sample.escaped = n < maxIterations;
+  if (sample.escaped) {
+    // Fractional part of the smooth iteration count
+    long double zn = std::sqrt((long double) (a * a + b * b));
+    sample.value = log2(log2(zn));
+  }
+  return sample;
+}
+
+Color getColorFromSample_Julia(const PointSample &sample, float maxIterations) {
+  if (!sample.escaped) { return BLACK; }
 
   // Smooth coloring
-  long double zn = sqrt(a * a + b * b);
-  long double smooth = n + 1 - log2(log2(zn));
+  float smooth = sample.n + 1 - sample.value;
 
   float hue = (float) (0.95f + 20.0f * smooth / maxIterations); // tweak multiplier
   hue = fmod(hue, 1.0f);                                       // keep hue in [0,1]
@@ -187,58 +223,75 @@ Color getColorFromPoint_Julia(long double a, long double b, float maxIterations)
 }
 
 // Burning ship
-Color getColorFromPoint_BurningShip(long double a, long double b, int maxIterations) {
-  long double x = 0, y = 0;
+template <typename Real>
+PointSample samplePoint_BurningShip(Real a, Real b, float maxIterations) {
+  Real x = 0, y = 0;
   int n = 0;
   while (x * x + y * y <= 4 && n < maxIterations)
   {
-    long double xtemp = x * x - y * y + a;
-    y = fabs(2 * x * y) + b;
-    x = fabs(xtemp);
+    Real xtemp = x * x - y * y + a;
+    y = std::abs(2 * x * y) + b;
+    x = std::abs(xtemp);
     n++;
   }
 
-  float t = (float)n / maxIterations;
-  return (n == maxIterations) ? BLACK : Color{(unsigned char)(9 * (1 - t) * t * t * t * 255), (unsigned char)(15 * (1 - t) * (1 - t) * t * t * 255), (unsigned char)(8.5 * (1 - t) * (1 - t) * (1 - t) * t * 255), 255};
+  PointSample sample;
+  sample.n = n;
+  sample.escaped = n < maxIterations;
+  return sample;
+}
+
+Color getColorFromSample_BurningShip(const PointSample &sample, float maxIterations) {
+  float t = sample.n / (int) maxIterations;
+  return !sample.escaped ? BLACK : Color{(unsigned char)(9 * (1 - t) * t * t * t * 255), (unsigned char)(15 * (1 - t) * (1 - t) * t * t * 255), (unsigned char)(8.5 * (1 - t) * (1 - t) * (1 - t) * t * 255), 255};
 }
 
 // Tricorn
-Color getColorFromPoint_Tricorn(long double a, long double b, int maxIterations) {
-  long double x = 0, y = 0;
+template <typename Real>
+PointSample samplePoint_Tricorn(Real a, Real b, float maxIterations) {
+  Real x = 0, y = 0;
   int n = 0;
   while (x * x + y * y <= 4 && n < maxIterations) {
-    long double xtemp = x * x - y * y + a;
+    Real xtemp = x * x - y * y + a;
     y = -2 * x * y + b;
     x = xtemp;
     n++;
   }
 
-  float t = (float)n / maxIterations;
-  return (n == maxIterations) ? BLACK : Color{(unsigned char)(255 * t), (unsigned char)(255 * (1 - t)), (unsigned char)(128 * t), 255};
+  PointSample sample;
+  sample.n = n;
+  sample.escaped = n < maxIterations;
+  return sample;
+}
+
+Color getColorFromSample_Tricorn(const PointSample &sample, float maxIterations) {
+  float t = sample.n / (int) maxIterations;
+  return !sample.escaped ? BLACK : Color{(unsigned char)(255 * t), (unsigned char)(255 * (1 - t)), (unsigned char)(128 * t), 255};
 }
 
 // Phoenix
-Color getColorFromPoint_Phoenix(long double a, long double b, int maxIterations) {
+template <typename Real>
+PointSample samplePoint_Phoenix(Real a, Real b, float maxIterations, const SetParameters &parameters) {
   // Complex parameters
-  long double cRe = a;
-  long double cIm = b;
+  Real cRe = a;
+  Real cIm = b;
 
-  // Phoenix constant p (can be tweaked for different visuals)
-  const long double pRe = -0.5;
-  const long double pIm = 0.0;
+  // Phoenix constant p
+  const Real pRe = (Real) parameters.phoenixRe;
+  const Real pIm = (Real) parameters.phoenixIm;
 
-  long double x = 0.0, y = 0.0;         // z_n
-  long double xPrev = 0.0, yPrev = 0.0; // z_{n-1}
+  Real x = 0, y = 0;         // z_n
+  Real xPrev = 0, yPrev = 0; // z_{n-1}
 
   int n = 0;
-  while ((x * x + y * y <= 4.0) && n < maxIterations) {
+  while ((x * x + y * y <= 4) && n < maxIterations) {
     // Complex multiplication: z_n^2
-    long double x2 = x * x - y * y;
-    long double y2 = 2 * x * y;
+    Real x2 = x * x - y * y;
+    Real y2 = 2 * x * y;
 
     // Add c and p * z_{n-1}
-    long double xTemp = x2 + cRe + (pRe * xPrev - pIm * yPrev);
-    long double yTemp = y2 + cIm + (pRe * yPrev + pIm * xPrev);
+    Real xTemp = x2 + cRe + (pRe * xPrev - pIm * yPrev);
+    Real yTemp = y2 + cIm + (pRe * yPrev + pIm * xPrev);
 
     xPrev = x;
     yPrev = y;
@@ -248,12 +301,23 @@ Color getColorFromPoint_Phoenix(long double a, long double b, int maxIterations)
     n++;
   }
 
-  if (n == maxIterations) { return BLACK; }
+  PointSample sample;
+  sample.n = n;
+  sample.escaped = n < (int) maxIterations;
+  if (sample.escaped) {
+    // Fractional part of the smooth iteration count
+    float zn = sqrt(x * x + y * y);
+    sample.value = log(log(zn)) / log(2.0);
+  }
+  return sample;
+}
+
+Color getColorFromSample_Phoenix(const PointSample &sample, float maxIterations) {
+  if (!sample.escaped) { return BLACK; }
 
   // Smooth coloring
-  float zn = sqrt(x * x + y * y);
-  float smooth = n + 1 - log(log(zn)) / log(2.0);
-  float t = smooth / maxIterations;
+  float smooth = sample.n + 1 - sample.value;
+  float t = smooth / (int) maxIterations;
 
   // Gradient: smooth rainbow
   unsigned char r = (unsigned char)(9 * (1 - t) * t * t * t * 255);
@@ -264,33 +328,86 @@ Color getColorFromPoint_Phoenix(long double a, long double b, int maxIterations)
 }
 
 // Lyapunov
-Color getColorFromPoint_Lyapunov(long double a, long double b, int maxIterations) {
-  // 'a' and 'b' represent rA and rB in the logistic map
-  const char *pattern = "AABAB"; // Feel free to change the pattern
-  int patternLength = strlen(pattern);
-
-  long double x = 0.5; // Starting value
-  long double lyap = 0.0;
-  bool stable = true;
-
-  for (int n = 0; n < maxIterations; n++) {
-    char ch = pattern[n % patternLength];
-    long double r = (ch == 'A') ? a : b;
-    x = r * x * (1.0 - x);
-    if (x <= 0.0 || x >= 1.0) {
-      stable = false;
-      break;
+// The exponent is the mean of log |r (1 - 2x)| along the orbit of the logistic map. The factors are multiplied together and the log
+// is only taken of their product every LYAPUNOV_BATCH iterations. They are at most 4, so the product can't overflow, but they get
+// as close to 0 as x gets to 0.5 : they are kept above LYAPUNOV_MIN_FACTOR so a batch can't underflow a double to 0 (log -inf)
+static const int LYAPUNOV_BATCH = 8;
+static const double LYAPUNOV_MIN_FACTOR = 1e-30;
+
+// Every point follows the same sequence, so the lanes pick a or b together and stay in step, the unstable ones are frozen
+template <typename Real, int Lanes>
+static void samplePointsLyapunov(const Real *a, const Real *b, PointSample *samples, float maxIterations, const SetParameters &parameters) {
+  using Product = typename std::conditional<(sizeof(Real) < sizeof(double)), double, Real>::type;
+  Real x[Lanes];
+  Product product[Lanes], exponent[Lanes];
+  int n[Lanes];
+  bool stable[Lanes];
+  for (int l = 0; l < Lanes; l++) {
+    x[l] = 0.5; // Starting value
+    product[l] = 1;
+    exponent[l] = 0;
+    n[l] = 0;
+    stable[l] = true;
+  }
+
+  const int warmup = std::max(0, parameters.lyapunovWarmup);
+  const int length = std::min(std::max(1, parameters.lyapunovLength), LYAPUNOV_MAX_SEQUENCE);
+  const int iterations = warmup + (int) maxIterations;
+  int step = 0; // Position in the sequence
+  bool anyStable = true;
+  for (int iteration = 0; iteration < iterations && anyStable; iteration++) {
+    const bool useB = (parameters.lyapunovSequence >> step) & 1;
+    step = step + 1 == length ? 0 : step + 1;
+    const bool measured = iteration >= warmup;
+
+    anyStable = false;
+    for (int l = 0; l < Lanes; l++) {
+      Real r = useB ? b[l] : a[l];
+      Real next = r * x[l] * (1 - x[l]);
+      // Leaving ]0, 1[ means the orbit diverges
+      bool inside = stable[l] && next > 0 && next < 1;
+      // A factor of 0 is left out, its log would swallow the whole exponent
+      Real factor = std::abs(r * (1 - 2 * next));
+      factor = factor > 0 ? std::max(factor, (Real) LYAPUNOV_MIN_FACTOR) : 1;
+      product[l] = inside && measured ? product[l] * factor : product[l];
+      x[l] = inside ? next : x[l];
+      // The warm-up is not part of the budget
+      n[l] += inside && measured;
+      stable[l] = inside;
+      anyStable |= inside;
+    }
+
+    if ((iteration + 1) % LYAPUNOV_BATCH == 0) {
+      for (int l = 0; l < Lanes; l++) {
+        exponent[l] += std::log(product[l]);
+        product[l] = 1;
+      }
+    }
+  }
+
+  // Unstable points are drawn black, they count as escaped
+  for (int l = 0; l < Lanes; l++) {
+    samples[l] = PointSample();
+    samples[l].n = n[l];
+    samples[l].escaped = !stable[l];
+    if (stable[l]) {
+      samples[l].value = (float) ((exponent[l] + std::log(product[l])) / (int) maxIterations);
     }
-    long double deriv = fabs(r * (1.0 - 2.0 * x));
-    if (deriv > 0.0) { lyap += log(deriv); }
   }
+}
 
-  if (!stable) { return BLACK; }
+template <typename Real>
+PointSample samplePoint_Lyapunov(Real a, Real b, float maxIterations, const SetParameters &parameters) {
+  PointSample sample;
+  samplePointsLyapunov<Real, 1>(&a, &b, &sample, maxIterations, parameters);
+  return sample;
+}
 
-  lyap /= maxIterations;
+Color getColorFromSample_Lyapunov(const PointSample &sample, float) {
+  if (sample.escaped) { return BLACK; }
 
   // --- Gradient coloring ---
-  float t = (float)((lyap + 2.0) / 4.0); // Normalize exponent range ~[-2,2] to [0,1]
+  float t = (float)((sample.value + 2.0) / 4.0); // Normalize exponent range ~[-2,2] to [0,1]
   t = fminf(fmaxf(t, 0.0f), 1.0f);       // Clamp
 
   // Warm fiery gradient: deep red to yellow
@@ -300,3 +417,355 @@ Color getColorFromPoint_Lyapunov(long double a, long double b, int maxIterations
 
   return Color{r, g, bl, 255};
 }
+
+
+// Sets by number, same order as the --set flag
+static const char *setNames[SET_COUNT] = {"mandelbrot", "julia", "burning-ship", "tricorn", "phoenix", "lyapunov", "mandelbrot-light"};
+const char *getSetName(int set) {
+  return (set >= 0 && set < SET_COUNT) ? setNames[set] : "unknown";
+}
+
+int getSetFromName(const std::string &name) {
+  for (int set = 0; set < SET_COUNT; set++) {
+    if (name == setNames[set] || name == std::to_string(set)) { return set; }
+  }
+  return -1;
+}
+
+bool parseComplex(const std::string &text, long double &re, long double &im) {
+  std::string numbers = text;
+  std::replace(numbers.begin(), numbers.end(), ',', ' ');
+  std::istringstream stream(numbers);
+  std::string rest;
+  return (bool) (stream >> re >> im) && !(stream >> rest);
+}
+
+bool parseLyapunovSequence(const std::string &text, SetParameters &parameters) {
+  if (text.empty() || (int) text.size() > LYAPUNOV_MAX_SEQUENCE) { return false; }
+  unsigned long long sequence = 0;
+  for (size_t i = 0; i < text.size(); i++) {
+    char letter = (char) std::toupper((unsigned char) text[i]);
+    if (letter != 'A' && letter != 'B') { return false; }
+    if (letter == 'B') { sequence |= 1ULL << i; }
+  }
+  parameters.lyapunovSequence = sequence;
+  parameters.lyapunovLength = (int) text.size();
+  return true;
+}
+
+std::string getLyapunovSequence(const SetParameters &parameters) {
+  std::string text;
+  for (int i = 0; i < parameters.lyapunovLength; i++) {
+    text += (parameters.lyapunovSequence >> i) & 1 ? 'B' : 'A';
+  }
+  return text;
+}
+
+template <typename Real>
+PointSample samplePoint(int set, Real a, Real b, float maxIterations, const SetParameters &parameters) {
+  switch (set) {
+    case SET_MANDELBROT: return samplePoint_Mandelbrot(a, b, maxIterations);
+    case SET_JULIA: return samplePoint_Julia(a, b, maxIterations, parameters);
+    case SET_BURNING_SHIP: return samplePoint_BurningShip(a, b, maxIterations);
+    case SET_TRICORN: return samplePoint_Tricorn(a, b, maxIterations);
+    case SET_PHOENIX: return samplePoint_Phoenix(a, b, maxIterations, parameters);
+    case SET_LYAPUNOV: return samplePoint_Lyapunov(a, b, maxIterations, parameters);
+    case SET_MANDELBROT_LIGHT_EFFECT: return samplePoint_Mandelbrot_LightEffect(a, b, maxIterations);
+    default: return PointSample();
+  }
+}
+
+Color getColorFromSample(int set, const PointSample &sample, float maxIterations) {
+  switch (set) {
+    case SET_MANDELBROT: return getColorFromSample_Mandelbrot(sample, maxIterations);
+    case SET_JULIA: return getColorFromSample_Julia(sample, maxIterations);
+    case SET_BURNING_SHIP: return getColorFromSample_BurningShip(sample, maxIterations);
+    case SET_TRICORN: return getColorFromSample_Tricorn(sample, maxIterations);
+    case SET_PHOENIX: return getColorFromSample_Phoenix(sample, maxIterations);
+    case SET_LYAPUNOV: return getColorFromSample_Lyapunov(sample, maxIterations);
+    case SET_MANDELBROT_LIGHT_EFFECT: return getColorFromSample_Mandelbrot_LightEffect(sample, maxIterations);
+    default: return BLACK;
+  }
+}
+
+template <typename Real>
+Color getColorFromPoint(int set, Real a, Real b, float maxIterations, const SetParameters &parameters) {
+  return getColorFromSample(set, samplePoint(set, a, b, maxIterations, parameters), maxIterations);
+}
+
+
+// Distance estimation
+bool hasDistanceEstimation(int set) {
+  return set == SET_MANDELBROT || set == SET_MANDELBROT_LIGHT_EFFECT || set == SET_JULIA || set == SET_BURNING_SHIP || set == SET_TRICORN;
+}
+
+template <typename Real>
+PointSample samplePointDistance(int set, Real a, Real b, float maxIterations, const SetParameters &parameters) {
+  if (!hasDistanceEstimation(set)) { return samplePoint(set, a, b, maxIterations, parameters); }
+
+  // Julia iterates from z = the point, with a derivative over z0, the others from z = 0 with a derivative over c
+  bool julia = set == SET_JULIA;
+  Real x = julia ? a : 0, y = julia ? b : 0;
+  Real ca = julia ? (Real) parameters.juliaRe : a, cb = julia ? (Real) parameters.juliaIm : b;
+  // Burning ship and Tricorn are not holomorphic, |dz| is bounded with 2 |z| |dz| + 1 instead
+  bool holomorphic = set != SET_BURNING_SHIP && set != SET_TRICORN;
+  Real dx = julia ? 1 : 0, dy = 0, dr = julia ? 1 : 0;
+
+  int n;
+  for (n = 0; n < maxIterations && x * x + y * y <= 1e6; n++) {
+    if (holomorphic) {
+      Real ndx = 2 * (x * dx - y * dy) + (julia ? 0 : 1);
+      dy = 2 * (x * dy + y * dx);
+      dx = ndx;
+    } else {
+      dr = 2 * std::sqrt(x * x + y * y) * dr + 1;
+    }
+
+    Real xx = x * x - y * y + ca;
+    Real xy = 2 * x * y;
+    switch (set) {
+      case SET_BURNING_SHIP: y = std::abs(xy) + cb; x = std::abs(xx); break;
+      case SET_TRICORN: y = -xy + cb; x = xx; break;
+      default: y = xy + cb; x = xx; break;
+    }
+  }
+
+  PointSample sample;
+  sample.n = n;
+  sample.escaped = n < maxIterations;
+  if (sample.escaped) {
+    // Half of |z| ln|z| / |dz|, the distance is between this and 4 times this (Koebe 1/4 theorem)
+    long double z = std::sqrt((long double) (x * x + y * y));
+    long double derivative = holomorphic ? std::sqrt((long double) (dx * dx + dy * dy)) : (long double) dr;
+    sample.distance = derivative > 0 ? (float) (0.5L * z * std::log(z) / derivative) : 0;
+  }
+  return sample;
+}
+
+Color getColorFromDistance(const PointSample &sample, long double zoom) {
+  if (!sample.escaped) { return BLACK; }
+  float t = std::min(1.0f, (float) (sample.distance * zoom) / DISTANCE_FADE);
+  unsigned char shade = (unsigned char) (255 * std::sqrt(t));
+  return Color{shade, shade, shade, 255};
+}
+
+
+// Interior detection
+bool hasInteriorDetection(int set) {
+  return set == SET_MANDELBROT || set == SET_MANDELBROT_LIGHT_EFFECT || set == SET_JULIA;
+}
+
+template <typename Real, int Set>
+static PointSample samplePointInterior(Real a, Real b, float maxIterations, const SetParameters &parameters) {
+  // Same iterations as the kernel of the set : the three start from the point, Julia with its own c
+  const bool julia = Set == SET_JULIA, light = Set == SET_MANDELBROT_LIGHT_EFFECT;
+  Real ca = julia ? (Real) parameters.juliaRe : a, cb = julia ? (Real) parameters.juliaIm : b;
+  Real bailout = julia ? 4 : light ? 10000 : 16;
+  Real x = a, y = b;
+  Real derX = 1, derY = 0; // Light effect only, derivative over c
+
+  // Point saved at the last checkpoint, the window doubles at every one
+  // Coming back this close is only a candidate, the multiplier of the cycle is then computed over one period
+  const Real tolerance = 1024 * std::numeric_limits<Real>::epsilon();
+  Real savedX = x, savedY = y;
+  int checkpoint = 0, window = 1;
+  int period = 0;
+  Real multiplier = 0;
+
+  int n;
+  for (n = 0; n < maxIterations && x * x + y * y <= bailout; n++) {
+    if (light) {
+      Real newDerX = derX * (2 * x) - derY * (2 * y) + 1;
+      derY = derX * (2 * y) + derY * (2 * x);
+      derX = newDerX;
+    }
+    Real xx = x * x - y * y + ca;
+    y = 2 * x * y + cb;
+    x = xx;
+
+    Real ex = x - savedX, ey = y - savedY;
+    if (ex * ex + ey * ey <= tolerance * tolerance) {
+      // The orbit came back after a multiple of the period, it is in an attracting cycle if the derivative of the orbit over its point
+      // along that return is below 1. The period is the first return close enough (the cycle points are much further apart)
+      int length = n + 1 - checkpoint;
+      Real cx = x, cy = y, dx = 1, dy = 0;
+      int firstReturn = length;
+      for (int k = 1; k <= length; k++) {
+        Real ndx = 2 * (cx * dx - cy * dy);
+        dy = 2 * (cx * dy + cy * dx);
+        dx = ndx;
+        Real cxx = cx * cx - cy * cy + ca;
+        cy = 2 * cx * cy + cb;
+        cx = cxx;
+        if (k < firstReturn && (cx - x) * (cx - x) + (cy - y) * (cy - y) <= 4096 * tolerance * tolerance) { firstReturn = k; }
+      }
+      if (dx * dx + dy * dy < 1) {
+        period = firstReturn;
+        // Multiplier of one period
+        multiplier = std::pow(std::sqrt(dx * dx + dy * dy), (Real) firstReturn / length);
+        // The period was iterated on top of the orbit, it doesn't count past the budget
+        n = std::min(n + 1 + length, (int) std::ceil(maxIterations));
+        break;
+      }
+    }
+    if (n + 1 - checkpoint == window) {
+      savedX = x;
+      savedY = y;
+      checkpoint = n + 1;
+      window *= 2;
+    }
+  }
+
+  PointSample sample;
+  if (period > 0) {
+    // Inside, the iterations done are kept for the statistics
+    sample.n = n;
+    sample.period = (unsigned short) std::min(period, 65535);
+    sample.value = (float) multiplier;
+    return sample;
+  }
+  sample.n = n;
+  sample.escaped = n < maxIterations;
+  if (sample.escaped && julia) {
+    long double zn = std::sqrt((long double) (x * x + y * y));
+    sample.value = log2(log2(zn));
+  }
+  if (sample.escaped && light) {
+    sample.value = getLightEffectValue<Real>(x, y, derX, derY);
+  }
+  return sample;
+}
+
+template <typename Real>
+PointSample samplePointInterior(int set, Real a, Real b, float maxIterations, const SetParameters &parameters) {
+  switch (set) {
+    case SET_MANDELBROT: return samplePointInterior<Real, SET_MANDELBROT>(a, b, maxIterations, parameters);
+    case SET_JULIA: return samplePointInterior<Real, SET_JULIA>(a, b, maxIterations, parameters);
+    case SET_MANDELBROT_LIGHT_EFFECT: return samplePointInterior<Real, SET_MANDELBROT_LIGHT_EFFECT>(a, b, maxIterations, parameters);
+    default: return samplePoint(set, a, b, maxIterations, parameters);
+  }
+}
+
+Color getColorFromInterior(const PointSample &sample) {
+  if (sample.escaped || sample.period == 0) { return BLACK; }
+  float hue = std::fmod(sample.period * 0.618034f, 1.0f);
+  return HSVtoRGB(hue, 0.6f, 0.3f + 0.7f * (1 - std::min(1.0f, sample.value)));
+}
+
+
+// Batches
+// Mandelbrot, Burning ship and Tricorn iterate a group of points together, with finished points frozen instead of branching,
+// so the compiler can keep every lane in one SIMD register
+template <typename Real, int Lanes, int Set>
+static void samplePointsLanes(const Real *a, const Real *b, PointSample *samples, float maxIterations) {
+  Real x[Lanes], y[Lanes];
+  int n[Lanes];
+  for (int l = 0; l < Lanes; l++) {
+    // The Mandelbrot kernel starts from z = c, the others from z = 0
+    x[l] = Set == SET_MANDELBROT ? a[l] : 0;
+    y[l] = Set == SET_MANDELBROT ? b[l] : 0;
+    n[l] = 0;
+  }
+  const Real bailout = Set == SET_MANDELBROT ? 16 : 4;
+
+  bool anyActive = true;
+  for (int iteration = 0; iteration < maxIterations && anyActive; iteration++) {
+    anyActive = false;
+    for (int l = 0; l < Lanes; l++) {
+      bool active = x[l] * x[l] + y[l] * y[l] <= bailout;
+      Real xx = x[l] * x[l] - y[l] * y[l] + a[l];
+      Real xy = 2 * x[l] * y[l];
+      Real ny;
+      switch (Set) {
+        case SET_BURNING_SHIP: ny = std::abs(xy) + b[l]; xx = std::abs(xx); break;
+        case SET_TRICORN: ny = -xy + b[l]; break;
+        default: ny = xy + b[l]; break;
+      }
+      x[l] = active ? xx : x[l];
+      y[l] = active ? ny : y[l];
+      n[l] += active;
+      anyActive |= active;
+    }
+  }
+
+  for (int l = 0; l < Lanes; l++) {
+    samples[l] = PointSample();
+    samples[l].n = n[l];
+    samples[l].escaped = n[l] < maxIterations;
+  }
+}
+
+template <typename Real, int Lanes>
+static void samplePointsLanes(int set, const Real *a, const Real *b, PointSample *samples, float maxIterations, const SetParameters &parameters) {
+  switch (set) {
+    case SET_MANDELBROT: samplePointsLanes<Real, Lanes, SET_MANDELBROT>(a, b, samples, maxIterations); break;
+    case SET_BURNING_SHIP: samplePointsLanes<Real, Lanes, SET_BURNING_SHIP>(a, b, samples, maxIterations); break;
+    case SET_TRICORN: samplePointsLanes<Real, Lanes, SET_TRICORN>(a, b, samples, maxIterations); break;
+    case SET_LYAPUNOV: samplePointsLyapunov<Real, Lanes>(a, b, samples, maxIterations, parameters); break;
+    default: break;
+  }
+}
+
+template <typename Real>
+void samplePoints(int set, const Real *a, const Real *b, PointSample *samples, int count, float maxIterations, int lanes, const SetParameters &parameters) {
+  bool batched = set == SET_MANDELBROT || set == SET_BURNING_SHIP || set == SET_TRICORN || set == SET_LYAPUNOV;
+  int i = 0;
+  if (batched && lanes >= 8) {
+    for (; i + 8 <= count; i += 8) { samplePointsLanes<Real, 8>(set, a + i, b + i, samples + i, maxIterations, parameters); }
+  }
+  if (batched && lanes >= 4) {
+    for (; i + 4 <= count; i += 4) { samplePointsLanes<Real, 4>(set, a + i, b + i, samples + i, maxIterations, parameters); }
+  }
+
+  // What is left, one by one
+  for (; i < count; i++) {
+    samples[i] = samplePoint(set, a[i], b[i], maxIterations, parameters);
+  }
+}
+
+
+// Precision
+static const char *precisionNames[PRECISION_COUNT] = {"float", "double", "long-double"};
+const char *getPrecisionName(int precision) {
+  return (precision >= 0 && precision < PRECISION_COUNT) ? precisionNames[precision] : "unknown";
+}
+
+int getPrecisionFromName(const std::string &name) {
+  for (int precision = 0; precision < PRECISION_COUNT; precision++) {
+    if (name == precisionNames[precision]) { return precision; }
+  }
+  return -1;
+}
+
+// Neighbouring pixels must still be distinct numbers, with some margin for the error of the iterations
+// The orbit itself goes up to the escape radius, so coordinates are never considered smaller than 2
+bool isPrecisionEnough(int precision, long double x, long double y, long double zoom) {
+  long double epsilon;
+  switch (precision) {
+    case PRECISION_FLOAT: epsilon = std::numeric_limits<float>::epsilon(); break;
+    case PRECISION_DOUBLE: epsilon = std::numeric_limits<double>::epsilon(); break;
+    default: epsilon = std::numeric_limits<long double>::epsilon(); break;
+  }
+  long double magnitude = std::max(std::max(std::abs(x), std::abs(y)), 2.0L);
+  return 1.0L / zoom >= 4 * magnitude * epsilon;
+}
+
+
+// Every set is available in every precision
+#define INSTANTIATE_SETS(Real) \
+  template PointSample samplePoint_Mandelbrot<Real>(Real, Real, float); \
+  template PointSample samplePoint_Mandelbrot_LightEffect<Real>(Real, Real, float); \
+  template PointSample samplePoint_Julia<Real>(Real, Real, float, const SetParameters &); \
+  template PointSample samplePoint_BurningShip<Real>(Real, Real, float); \
+  template PointSample samplePoint_Tricorn<Real>(Real, Real, float); \
+  template PointSample samplePoint_Phoenix<Real>(Real, Real, float, const SetParameters &); \
+  template PointSample samplePoint_Lyapunov<Real>(Real, Real, float, const SetParameters &); \
+  template PointSample samplePoint<Real>(int, Real, Real, float, const SetParameters &); \
+  template PointSample samplePointDistance<Real>(int, Real, Real, float, const SetParameters &); \
+  template PointSample samplePointInterior<Real>(int, Real, Real, float, const SetParameters &); \
+  template Color getColorFromPoint<Real>(int, Real, Real, float, const SetParameters &); \
+  template void samplePoints<Real>(int, const Real *, const Real *, PointSample *, int, float, int, const SetParameters &);
+
+INSTANTIATE_SETS(float)
+INSTANTIATE_SETS(double)
+INSTANTIATE_SETS(long double)
@@ -0,0 +1,73 @@
+#include "tile_buffer_pool.hpp"
+#include <cstddef>
+#include <iostream>
+
+
+TileBufferPool::TileBufferPool(int bufferCount, int pixelsPerBuffer)
+    : pixelsPerBuffer(pixelsPerBuffer), pixels((size_t) bufferCount * pixelsPerBuffer), states(bufferCount, FREE) {
+  // Lowest buffers are handed out first
+  for (int i = bufferCount - 1; i >= 0; i--) {
+    freeBuffers.push_back(i);
+  }
+}
+
+// -1 (and reported) if the pointer is not the start of one of the buffers
+int TileBufferPool::getIndex(const Color *buffer) const {
+  std::ptrdiff_t offset = buffer - pixels.data();
+  if (buffer == nullptr || offset < 0 || offset >= (std::ptrdiff_t) pixels.size() || offset % pixelsPerBuffer != 0) {
+    std::cerr << "Pixels " << (const void *) buffer << " are not a tile buffer of the pool" << std::endl;
+    return -1;
+  }
+  return (int) (offset / pixelsPerBuffer);
+}
+
+Color *TileBufferPool::acquire() {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (freeBuffers.empty()) { return nullptr; }
+
+  int index = freeBuffers.back();
+  freeBuffers.pop_back();
+  states[index] = IN_USE;
+  return pixels.data() + (size_t) index * pixelsPerBuffer;
+}
+
+// Ownership mistakes would show up as corrupted tiles much later, report them where they happen
+void TileBufferPool::setState(Color *buffer, State from, State to) {
+  std::lock_guard<std::mutex> lock(mutex);
+  int index = getIndex(buffer);
+  if (index < 0) { return; }
+  if (states[index] != from) {
+    std::cerr << "Tile buffer " << index << " is in state " << states[index] << ", expected " << from << std::endl;
+  }
+  states[index] = to;
+}
+
+void TileBufferPool::markReady(Color *buffer) {
+  setState(buffer, IN_USE, READY);
+}
+
+void TileBufferPool::markCached(Color *buffer) {
+  setState(buffer, READY, CACHED);
+}
+
+void TileBufferPool::release(Color *buffer) {
+  std::lock_guard<std::mutex> lock(mutex);
+  int index = getIndex(buffer);
+  if (index < 0) { return; }
+  if (states[index] == FREE) {
+    std::cerr << "Tile buffer " << index << " released twice" << std::endl;
+    return;
+  }
+  states[index] = FREE;
+  freeBuffers.push_back(index);
+}
+
+int TileBufferPool::getCount(State state) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (state == FREE) { return (int) freeBuffers.size(); }
+  int count = 0;
+  for (State s : states) {
+    if (s == state) { count++; }
+  }
+  return count;
+}
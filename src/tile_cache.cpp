@@ -0,0 +1,68 @@
+#include "tile_cache.hpp"
+
+
+size_t TileKeyHash::operator()(const TileKey &key) const {
+  size_t hash = std::hash<int>()(key.set);
+  auto combine = [&hash](size_t value) { hash ^= value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2); };
+  combine(std::hash<int>()(key.index));
+  combine(std::hash<float>()(key.maxIterations));
+  combine(std::hash<long double>()(key.cx));
+  combine(std::hash<long double>()(key.cy));
+  combine(std::hash<long double>()(key.cz));
+  combine(std::hash<int>()(key.coloring));
+  combine(std::hash<int>()(key.interior));
+  combine(std::hash<long double>()(key.parameters.juliaRe));
+  combine(std::hash<long double>()(key.parameters.juliaIm));
+  combine(std::hash<long double>()(key.parameters.phoenixRe));
+  combine(std::hash<long double>()(key.parameters.phoenixIm));
+  combine(std::hash<unsigned long long>()(key.parameters.lyapunovSequence));
+  combine(std::hash<int>()(key.parameters.lyapunovLength));
+  combine(std::hash<int>()(key.parameters.lyapunovWarmup));
+  return hash;
+}
+
+void TileCache::drop(Color *pixels) {
+  if (release) {
+    release(pixels);
+  } else {
+    delete[] pixels;
+  }
+}
+
+TileCache::~TileCache() {
+  for (Entry &entry : entries) {
+    drop(entry.pixels);
+  }
+}
+
+const Color *TileCache::find(const TileKey &key) {
+  auto it = lookup.find(key);
+  if (it == lookup.end()) {
+    misses++;
+    return nullptr;
+  }
+
+  hits++;
+  entries.splice(entries.begin(), entries, it->second);
+  return it->second->pixels;
+}
+
+void TileCache::put(const TileKey &key, Color *pixels) {
+  auto it = lookup.find(key);
+  if (it != lookup.end()) {
+    drop(it->second->pixels);
+    it->second->pixels = pixels;
+    entries.splice(entries.begin(), entries, it->second);
+    return;
+  }
+
+  entries.push_front({key, pixels});
+  lookup[key] = entries.begin();
+
+  // Drop the least recently used tiles
+  while ((int) entries.size() > capacity) {
+    lookup.erase(entries.back().key);
+    drop(entries.back().pixels);
+    entries.pop_back();
+  }
+}
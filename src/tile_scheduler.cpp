@@ -0,0 +1,175 @@
+#include "tile_scheduler.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <cmath>
+
+// How far ahead the camera movement is followed when ordering the tiles (in seconds)
+static const float LOOKAHEAD = 0.25f;
+
+
+// Do a spiral
+static std::vector<int> getSpiralIndicesOutward(int TILES_X, int TILES_Y) {
+  std::vector<int> result;
+  std::vector<std::vector<bool>> visited(TILES_Y, std::vector<bool>(TILES_X, false));
+
+  // Starting position (center)
+  int startX = TILES_X / 2;
+  int startY = TILES_Y / 2;
+
+  // Direction vectors: right, down, left, up
+  int dx[] = {1, 0, -1, 0};
+  int dy[] = {0, 1, 0, -1};
+  int direction = 0;
+
+  int x = startX, y = startY;
+  int steps = 1;
+
+  // Add center point
+  result.push_back(x + y * TILES_X);
+  visited[y][x] = true;
+
+  while ((int) result.size() < TILES_X * TILES_Y) {
+    for (int i = 0; i < 2; i++) { // Move in current direction twice per spiral layer
+      for (int step = 0; step < steps; step++) {
+        x += dx[direction];
+        y += dy[direction];
+
+        if (x >= 0 && x < TILES_X && y >= 0 && y < TILES_Y && !visited[y][x]) {
+          result.push_back(x + y * TILES_X);
+          visited[y][x] = true;
+        }
+      }
+      direction = (direction + 1) % 4; // Turn 90 degrees
+    }
+    steps++; // Increase step count for next spiral layer
+  }
+
+  return result;
+}
+
+TileScheduler::TileScheduler(int tilesX, int tilesY) : tilesX(tilesX), tilesY(tilesY), spiralIndicesOutward(getSpiralIndicesOutward(tilesX, tilesY)) {
+  focus.x = tilesX / 2.0f;
+  focus.y = tilesY / 2.0f;
+}
+
+// Distance from the focus to where the tile will be on screen, tiles about to leave the screen go last
+float TileScheduler::getPriority(int index) const {
+  float centerX = tilesX / 2.0f, centerY = tilesY / 2.0f;
+  float scale = std::exp(focus.zoomRate * LOOKAHEAD);
+  float x = centerX + (index % tilesX + 0.5f - centerX) * scale - focus.velocityX * LOOKAHEAD;
+  float y = centerY + (index / tilesX + 0.5f - centerY) * scale - focus.velocityY * LOOKAHEAD;
+
+  float priority = std::hypot(x - focus.x, y - focus.y);
+  if (x < 0 || x > tilesX || y < 0 || y > tilesY) { priority += tilesX + tilesY; }
+  return priority;
+}
+
+// True if a should be computed after b
+bool TileScheduler::isLater(const QueuedTile &a, const QueuedTile &b) const {
+  if (prioritizeFocus) {
+    // A new view preempts everything queued for the previous ones
+    if (a.tile.generation != b.tile.generation) { return a.tile.generation < b.tile.generation; }
+    if (a.priority != b.priority) { return a.priority > b.priority; }
+  }
+  return a.order > b.order;
+}
+
+void TileScheduler::setFocus(const TileFocus &newFocus) {
+  focus = newFocus;
+  if (!prioritizeFocus || pendingTiles.empty()) { return; }
+
+  for (QueuedTile &queued : pendingTiles) {
+    queued.priority = getPriority(queued.tile.index);
+  }
+  std::make_heap(pendingTiles.begin(), pendingTiles.end(), [this](const QueuedTile &a, const QueuedTile &b) { return isLater(a, b); });
+}
+
+// Adds the tile to the queue, with all needed information to compute the pixels (the heap is rebuilt by scheduleView)
+void TileScheduler::scheduleTile(const PendingTile &pendingTile) {
+  // Remove tile from pending list if it was already scheduled (optional, but makes the app faster)
+  if (avoidDuplicates && tilesScheduled.find(pendingTile.index) != tilesScheduled.end()) {
+    for (auto it = pendingTiles.begin(); it != pendingTiles.end(); ++it) {
+      if (it->tile.index == pendingTile.index) {
+        traceInstant("replace", it->tile.index, it->tile.generation);
+        *it = pendingTiles.back();
+        pendingTiles.pop_back();
+        break;
+      }
+    }
+  }
+
+  // Add tile to the queue
+  pendingTiles.push_back({pendingTile, prioritizeFocus ? getPriority(pendingTile.index) : 0, tilesQueued++});
+  tilesScheduled.insert(pendingTile.index);
+  traceInstant("enqueue", pendingTile.index, pendingTile.generation);
+}
+
+void TileScheduler::scheduleView(long double cx, long double cy, long double cz, int generation, float maxIterations, long double diffX, long double diffY) {
+  auto scheduleTile = [this, cx, cy, cz, generation, maxIterations] (int i) {
+    this->scheduleTile({i, cx, cy, cz, generation, maxIterations});
+  };
+
+  // Do a spiral pattern if simply zooming in or out
+  if (diffX == 0 && diffY == 0) {
+    for (const int index : spiralIndicesOutward) {
+      scheduleTile(index);
+    }
+  }
+  // Change the order of the tiles based on movement direction
+  else if (diffX >= 0) {
+    if (diffY >= 0) {
+      // Top left
+      for (int i = 0; i < tilesX; ++i) {
+        for (int j = 0; j < tilesY; ++j) {
+          scheduleTile(j * tilesX + i);
+        }
+      }
+    }
+    else {
+      // Bottom left
+      for (int i = 0; i < tilesX; ++i) {
+        for (int j = tilesY - 1; j >= 0; --j) {
+          scheduleTile(j * tilesX + i);
+        }
+      }
+    }
+  }
+  else {
+    if (diffY >= 0) {
+      // Top right
+      for (int i = tilesX - 1; i >= 0; --i) {
+        for (int j = 0; j < tilesY; ++j) {
+          scheduleTile(j * tilesX + i);
+        }
+      }
+    }
+    else {
+      // Bottom right
+      for (int i = tilesX - 1; i >= 0; --i) {
+        for (int j = tilesY - 1; j >= 0; --j) {
+          scheduleTile(j * tilesX + i);
+        }
+      }
+    }
+  }
+
+  std::make_heap(pendingTiles.begin(), pendingTiles.end(), [this](const QueuedTile &a, const QueuedTile &b) { return isLater(a, b); });
+}
+
+bool TileScheduler::pop(PendingTile &tile) {
+  if (pendingTiles.empty()) { return false; }
+  std::pop_heap(pendingTiles.begin(), pendingTiles.end(), [this](const QueuedTile &a, const QueuedTile &b) { return isLater(a, b); });
+  tile = pendingTiles.back().tile;
+  pendingTiles.pop_back();
+  tilesScheduled.erase(tile.index);
+  traceInstant("dequeue", tile.index, tile.generation);
+  return true;
+}
+
+void TileScheduler::clear() {
+  for (const QueuedTile &queued : pendingTiles) {
+    traceInstant("cancel", queued.tile.index, queued.tile.generation);
+  }
+  pendingTiles.clear();
+  tilesScheduled.clear();
+}
@@ -0,0 +1,163 @@
+#include "trace.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+
+bool tracing = false;
+
+struct TraceEvent {
+  const char *name;
+  char phase; // 'i' : instant, 'X' : complete
+  int tile, generation;
+  int thread;
+  double start, duration;
+};
+
+// Written by one thread at a time, without locking
+// A thread gets a buffer on its first event and gives it back when it ends, so the short-lived tile threads reuse a few buffers
+// Each buffer is one row of the trace
+struct TraceBuffer {
+  static const int SIZE = 1 << 15; // Power of two
+  TraceEvent events[SIZE];
+  std::atomic<uint64_t> written{0};
+  const char *name = nullptr;
+};
+
+static std::string tracePath;
+static std::chrono::steady_clock::time_point traceStart;
+// Never destroyed : threads of global pools give their buffer back after the statics of this file are gone
+static std::mutex &buffersMutex = *new std::mutex();
+static std::vector<TraceBuffer *> &buffers = *new std::vector<TraceBuffer *>();
+static std::vector<TraceBuffer *> &freeBuffers = *new std::vector<TraceBuffer *>();
+static std::atomic<int> threadCount{0};
+
+// Buffer of the calling thread, given back when the thread ends
+struct ThreadTrace {
+  TraceBuffer *buffer = nullptr;
+  int thread = -1;
+
+  ~ThreadTrace() {
+    if (buffer == nullptr) { return; }
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    freeBuffers.push_back(buffer);
+  }
+};
+static thread_local ThreadTrace threadTrace;
+
+static ThreadTrace &getThreadTrace() {
+  if (threadTrace.buffer == nullptr) {
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    if (freeBuffers.empty()) {
+      buffers.push_back(new TraceBuffer());
+      threadTrace.buffer = buffers.back();
+    } else {
+      threadTrace.buffer = freeBuffers.back();
+      freeBuffers.pop_back();
+      // The name was the one of the previous thread
+      threadTrace.buffer->name = nullptr;
+    }
+    threadTrace.thread = threadCount.fetch_add(1, std::memory_order_relaxed);
+  }
+  return threadTrace;
+}
+
+static void record(const char *name, char phase, int tile, int generation, double start, double duration) {
+  ThreadTrace &trace = getThreadTrace();
+  TraceBuffer &buffer = *trace.buffer;
+  uint64_t index = buffer.written.load(std::memory_order_relaxed);
+  buffer.events[index & (TraceBuffer::SIZE - 1)] = {name, phase, tile, generation, trace.thread, start, duration};
+  buffer.written.store(index + 1, std::memory_order_release);
+}
+
+void startTrace(const std::string &path) {
+  tracePath = path;
+  traceStart = std::chrono::steady_clock::now();
+  tracing = true;
+}
+
+double getTraceTime() {
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - traceStart).count();
+}
+
+void traceInstant(const char *name, int tile, int generation) {
+  if (!tracing) { return; }
+  record(name, 'i', tile, generation, getTraceTime(), 0);
+}
+
+void traceComplete(const char *name, int tile, int generation, double start, double end) {
+  if (!tracing) { return; }
+  record(name, 'X', tile, generation, start, end - start);
+}
+
+void traceThreadName(const char *name) {
+  if (!tracing) { return; }
+  TraceBuffer *buffer = getThreadTrace().buffer;
+  // writeTrace() reads it with the lock held
+  std::lock_guard<std::mutex> lock(buffersMutex);
+  buffer->name = name;
+}
+
+bool writeTrace() {
+  if (tracePath.empty()) { return false; }
+
+  std::string tempPath = tracePath + ".tmp";
+  {
+    std::ofstream file(tempPath);
+    file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool first = true;
+
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    for (size_t row = 0; row < buffers.size(); row++) {
+      TraceBuffer &buffer = *buffers[row];
+
+      // Copy the events, then drop the ones the owner may have overwritten while they were copied
+      uint64_t end = buffer.written.load(std::memory_order_acquire);
+      uint64_t begin = end > (uint64_t) TraceBuffer::SIZE ? end - TraceBuffer::SIZE : 0;
+      std::vector<TraceEvent> events;
+      for (uint64_t i = begin; i < end; i++) {
+        events.push_back(buffer.events[i & (TraceBuffer::SIZE - 1)]);
+      }
+      uint64_t overwritten = buffer.written.load(std::memory_order_acquire);
+      size_t skip = overwritten > end ? std::min<uint64_t>(overwritten - end, events.size()) : 0;
+
+      char line[256];
+      snprintf(line, sizeof(line), "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s %d\"}}",
+               (int) row, buffer.name != nullptr ? buffer.name : "worker", (int) row);
+      file << (first ? "" : ",\n") << line;
+      first = false;
+
+      for (size_t i = skip; i < events.size(); i++) {
+        const TraceEvent &event = events[i];
+        int length = snprintf(line, sizeof(line), "{\"name\": \"%s\", \"ph\": \"%c\", \"ts\": %.3f, ", event.name, event.phase, event.start);
+        if (event.phase == 'X') {
+          length += snprintf(line + length, sizeof(line) - length, "\"dur\": %.3f, ", event.duration);
+        } else {
+          length += snprintf(line + length, sizeof(line) - length, "\"s\": \"t\", ");
+        }
+        snprintf(line + length, sizeof(line) - length, "\"pid\": 1, \"tid\": %d, \"args\": {\"tile\": %d, \"generation\": %d, \"thread\": %d}}",
+                 (int) row, event.tile, event.generation, event.thread);
+        file << ",\n" << line;
+      }
+    }
+    file << "\n]}\n";
+
+    if (!file.good()) {
+      std::cerr << "Could not write " << tempPath << std::endl;
+      return false;
+    }
+  }
+
+  if (std::rename(tempPath.c_str(), tracePath.c_str()) != 0) {
+    std::cerr << "Could not write " << tracePath << std::endl;
+    return false;
+  }
+  std::cout << "Trace written to " << tracePath << std::endl;
+  return true;
+}
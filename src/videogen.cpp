@@ -1,45 +1,126 @@
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "stb_image_write.h"
 #include <thread>
 #include <iostream>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <set>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+#include <memory>
+#include <sys/wait.h>
+#include <unistd.h>
 
 // Own implementations
 #include "sets_definition.hpp"
+#include "frame_queue.hpp"
+#include "reference_orbit.hpp"
+#include "trace.hpp"
+#include "renderer.hpp"
+#include "histogram.hpp"
+#include "image_writer.hpp"
 
 
-// Constants
-const int SCREEN_WIDTH = 1280;
-const int SCREEN_HEIGHT = 720;
-const int MAX_ITERATIONS = 3000;
-const int FPS = 24;
-const int DURATION = 10; // In seconds
+// Job description (changeable with a job file, see jobs/default.job, or with flags named like its keys)
+// What set to render and with what floating point type
+int SET = SET_MANDELBROT;
+int PRECISION = PRECISION_LONG_DOUBLE;
+// Julia c and Phoenix p ("re,im"), Lyapunov sequence and warm-up
+SetParameters PARAMETERS;
+int SCREEN_WIDTH = 1280;
+int SCREEN_HEIGHT = 720;
+int FPS = 24;
+int DURATION = 10; // In seconds
+// Iterations ramp linearly from MAX_ITERATIONS on the first frame to MAX_ITERATIONS_END on the last one
+int MAX_ITERATIONS = 3000;
+int MAX_ITERATIONS_END = -1; // Same as MAX_ITERATIONS if not set
+// Or let each frame get the iterations its view needs (iterations = auto), between MIN_ITERATIONS and AUTO_MAX_ITERATIONS
+bool AUTO_ITERATIONS = false;
+int MIN_ITERATIONS = 100;
+int AUTO_MAX_ITERATIONS = 1000000;
+// Fraction of the pixels allowed to escape in the last half of the budget, more means some are probably cut short
+float ITERATIONS_TOLERANCE = 0.001f;
 
-// What to capture
-const long double CAMERA_X = -0.685125052928924560546875000000000000;
-const long double CAMERA_Y = 0.314403444528579711914062500000000000;
-const long double TARGET_ZOOM = 86977941057044480.000000000000000000000000000000000000;
+// Extra samples for the pixels on the edges of the color bands, averaged with them (0 : no anti-aliasing)
+int AA_SAMPLES = 0;
+// Palette of the set from the iterations, distance to the set, or gradient spread by the histogram of each frame
+int COLORING = COLORING_ITERATIONS;
+// Points inside the set stop once their orbit fell in a cycle (off, detect, or period to color them by the cycle)
+int INTERIOR = INTERIOR_OFF;
+
+// Iterate Mandelbrot pixels in double around one long double reference orbit shared by every frame (on, off or auto)
+// auto only uses it when double alone is not precise enough for the path
+std::string REFERENCE_ORBIT = "auto";
+
+// Where the frames and the manifest of finished frames are written, and in what format
+std::string OUTPUT_DIR = "frames";
+std::string OUTPUT_FORMAT = "png"; // png, qoi, ppm or pam
+// PNG compression level (0 : stored, fastest) and row filter (-1 : best of all filters on each row)
+ImageOptions IMAGE_OPTIONS;
+// Only validate the job and print what would be rendered (--check)
+bool CHECK_ONLY = false;
+// Skips the frames listed in the manifest of a previous (interrupted) run (--resume)
+bool RESUME = false;
+// Where to write the timeline of the tiles and frames, nothing if empty (--trace), queue workers add their pid to it
+std::string TRACE_PATH = "";
+
+// Sharding, to split a video between several processes or machines
+// Only render frames FIRST_FRAME..LAST_FRAME (--frames first-last)
+int FIRST_FRAME = 0;
+int LAST_FRAME = -1;
+// Only render frames where frame % SHARD_COUNT == SHARD_INDEX (--shard index/count)
+int SHARD_INDEX = 0;
+int SHARD_COUNT = 1;
+// Take chunks of frames from a shared-directory queue instead (--queue dir), until the whole video is done
+std::string QUEUE_DIR = "";
+int CHUNK_SIZE = 8;
+int STALE_AFTER = 60; // In seconds
+// Claims are touched this often while their chunk renders, a claim is only stale after several missed heartbeats
+const int HEARTBEAT_SECONDS = 1;
+const int MIN_STALE_AFTER = 3 * HEARTBEAT_SECONDS;
+// Spawn this many local worker processes on the queue, and respawn the ones that crash (--workers count)
+int WORKERS = 0;
+
+// What to capture, zooming from zoom to TARGET_ZOOM towards the camera position
+long double CAMERA_X = -0.685125052928924560546875000000000000;
+long double CAMERA_Y = 0.314403444528579711914062500000000000;
+long double TARGET_ZOOM = 86977941057044480.000000000000000000000000000000000000;
 long double zoom = 500;
 
+// Or follow a path through keyframes instead
+struct Keyframe {
+  int frame;
+  long double x, y, zoom;
+};
+std::vector<Keyframe> keyframes;
+
 // How many horizontal and vertical tiles to create
-const int TILES_X = 16;
-const int TILES_Y = 9;
+int TILES_X = 16;
+int TILES_Y = 9;
 
-// Detaches the threads, can speedup the rendering but uses more resources
+// Renders the tiles in the background, can speedup the rendering but uses more resources
 const bool DETACHED_MODE = true;
-const int MAX_THREADS = std::thread::hardware_concurrency();
+int MAX_THREADS = std::thread::hardware_concurrency();
 
-// Other
-const int tileCount = TILES_X * TILES_Y;
-const int tileWidth = SCREEN_WIDTH / TILES_X;
-const int tileHeight = SCREEN_HEIGHT / TILES_Y;
-const int pixelCount = tileWidth * tileHeight;
-const int frameCount = FPS * DURATION; // 20 seconds of video
-const long double zoomStep = pow(TARGET_ZOOM / zoom, 1.0L / frameCount);
+// Other (computed from the job)
+int tileCount;
+int tileWidth;
+int tileHeight;
+int frameCount;
+std::vector<Keyframe> path;
+std::vector<float> plannedIterations; // Only with automatic iterations
+bool useReferenceOrbit = false;
+ReferenceOrbit referenceOrbit;
 
 // CODE //
 
 // Multi-threading
-std::atomic<int> runningThreads(0);
+std::unique_ptr<RenderPool> renderPool; // Only created by the processes that render
 struct PendingTile {
   int index;
   long double cx, cy, z;
@@ -50,9 +131,8 @@ std::deque<PendingTile> pendingTiles;
 
 // Tile structure
 struct Tile {
-  // Textures
+  // Position in the frame (its pixels are in the buffer of the frame)
   int tileX, tileY;
-  std::vector<Color> pixels;
   bool hasComputed = false;
 
   // Which frame it belongs to
@@ -70,68 +150,474 @@ struct Frame {
   // Count of the number of tiles that have been computed
   int tilesComputed = 0;
 
+  // Whole frame, the tiles are computed straight into it (taken from the pool when the first tile starts)
+  Color *pixels = nullptr;
+  // With histogram coloring, the samples of the whole frame and their histogram, the pixels are colored again once the last tile is done
+  std::vector<PointSample> samples;
+  std::unique_ptr<HistogramAccumulator> histogram;
+
   int generation = 0;
 };
 
+// Frame buffers, reused from one frame to the next instead of allocated for each
+// Only as many buffers as frames in flight are ever allocated
+struct FramePool {
+  ~FramePool() {
+    for (Color *buffer : freeBuffers) { delete[] buffer; }
+  }
+
+  Color *acquire() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (freeBuffers.empty()) {
+      allocated++;
+      return new Color[SCREEN_WIDTH * SCREEN_HEIGHT];
+    }
+    Color *buffer = freeBuffers.back();
+    freeBuffers.pop_back();
+    return buffer;
+  }
+
+  void release(Color *buffer) {
+    std::lock_guard<std::mutex> lock(mutex);
+    freeBuffers.push_back(buffer);
+  }
+
+  int getAllocated() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return allocated;
+  }
+
+private:
+  std::mutex mutex;
+  std::vector<Color *> freeBuffers;
+  int allocated = 0;
+};
+FramePool framePool;
+
 // List of all the frames
-std::vector<Frame> frames(frameCount);
+std::vector<Frame> frames;
+
+// Manifest of finished frames, so an interrupted run can be resumed
+std::mutex manifestMutex;
+std::set<int> completedFrames;
+
+// The job in the job file format, with every value resolved (output location and threads don't change the frames)
+std::string getJobDescription() {
+  std::ostringstream description;
+  description.precision(21);
+  description << "set = " << getSetName(SET) << "\n";
+  description << "precision = " << getPrecisionName(PRECISION) << "\n";
+  description << "width = " << SCREEN_WIDTH << "\n" << "height = " << SCREEN_HEIGHT << "\n";
+  description << "fps = " << FPS << "\n" << "duration = " << DURATION << "\n";
+  if (AUTO_ITERATIONS) {
+    description << "iterations = auto\n" << "iterations-min = " << MIN_ITERATIONS << "\n" << "iterations-max = " << AUTO_MAX_ITERATIONS << "\n";
+    description << "iterations-tolerance = " << ITERATIONS_TOLERANCE << "\n";
+  } else {
+    description << "iterations = " << MAX_ITERATIONS << "\n" << "iterations-end = " << MAX_ITERATIONS_END << "\n";
+  }
+  description << "format = " << OUTPUT_FORMAT << "\n";
+  // Only when set, so jobs from before keep their signature
+  if (AA_SAMPLES > 0) { description << "aa-samples = " << AA_SAMPLES << "\n"; }
+  if (COLORING != COLORING_ITERATIONS) { description << "coloring = " << getColoringName(COLORING) << "\n"; }
+  if (INTERIOR != INTERIOR_OFF) { description << "interior = " << getInteriorName(INTERIOR) << "\n"; }
+  const SetParameters defaults;
+  if (SET == SET_JULIA && (PARAMETERS.juliaRe != defaults.juliaRe || PARAMETERS.juliaIm != defaults.juliaIm)) {
+    description << "julia-c = " << PARAMETERS.juliaRe << "," << PARAMETERS.juliaIm << "\n";
+  }
+  if (SET == SET_PHOENIX && (PARAMETERS.phoenixRe != defaults.phoenixRe || PARAMETERS.phoenixIm != defaults.phoenixIm)) {
+    description << "phoenix-p = " << PARAMETERS.phoenixRe << "," << PARAMETERS.phoenixIm << "\n";
+  }
+  if (SET == SET_LYAPUNOV && (PARAMETERS.lyapunovSequence != defaults.lyapunovSequence || PARAMETERS.lyapunovLength != defaults.lyapunovLength)) {
+    description << "lyapunov-sequence = " << getLyapunovSequence(PARAMETERS) << "\n";
+  }
+  if (SET == SET_LYAPUNOV && PARAMETERS.lyapunovWarmup != defaults.lyapunovWarmup) {
+    description << "lyapunov-warmup = " << PARAMETERS.lyapunovWarmup << "\n";
+  }
+  description << "reference-orbit = " << (useReferenceOrbit ? "on" : "off") << "\n";
+  for (const Keyframe& keyframe : path) {
+    description << "keyframe = " << keyframe.frame << " " << keyframe.x << " " << keyframe.y << " " << keyframe.zoom << "\n";
+  }
+  return description.str();
+}
+
+// Identifies the job, a manifest or a queue is only reused if it was written for the same video
+std::string getJobSignature() {
+  // FNV-1a, stable across machines (unlike std::hash) so workers can compare it
+  unsigned long long hash = 14695981039346656037ULL;
+  for (const char c : getJobDescription()) {
+    hash = (hash ^ (unsigned char) c) * 1099511628211ULL;
+  }
+
+  char signature[128];
+  snprintf(signature, sizeof(signature), "job %dx%d %d frames %016llx", SCREEN_WIDTH, SCREEN_HEIGHT, frameCount, hash);
+  return signature;
+}
+
+// Each shard keeps its own manifest, so processes sharing the output directory don't overwrite each other
+std::string getShardSuffix() {
+  std::string suffix;
+  if (LAST_FRAME >= 0) {
+    suffix += "-frames-" + std::to_string(FIRST_FRAME) + "-" + std::to_string(LAST_FRAME);
+  }
+  if (SHARD_COUNT > 1) {
+    suffix += "-shard-" + std::to_string(SHARD_INDEX) + "-of-" + std::to_string(SHARD_COUNT);
+  }
+  return suffix;
+}
+
+std::string getManifestPath() {
+  return OUTPUT_DIR + "/manifest" + getShardSuffix() + ".txt";
+}
+
+// Where long reference orbits are spilled, and found again when resuming
+std::string getOrbitPath() {
+  return OUTPUT_DIR + "/orbit" + getShardSuffix() + ".bin";
+}
+
+std::string getFramePath(int generation) {
+  char filename[64];
+  snprintf(filename, sizeof(filename), "/frame%05d.%s", generation, OUTPUT_FORMAT.c_str());
+  return OUTPUT_DIR + std::string(filename);
+}
+
+// Rewrite the whole manifest in a temporary file, then rename it so it is never half written
+// Must be called with manifestMutex held
+bool writeManifest() {
+  std::string path = getManifestPath();
+  std::string tempPath = path + ".tmp";
+
+  FILE *file = fopen(tempPath.c_str(), "w");
+  if (file == nullptr) { return false; }
+  fprintf(file, "%s\n", getJobSignature().c_str());
+  for (const int frame : completedFrames) {
+    fprintf(file, "frame %d\n", frame);
+  }
+  bool ok = fflush(file) == 0;
+  ok = (fclose(file) == 0) && ok;
+
+  return ok && std::rename(tempPath.c_str(), path.c_str()) == 0;
+}
+
+// Load the finished frames of a previous run, only keeping the ones whose file is still there
+void loadManifest() {
+  std::ifstream file(getManifestPath());
+  if (!file.is_open()) {
+    std::cout << "No manifest found, starting from scratch" << std::endl;
+    return;
+  }
+
+  std::string line;
+  std::getline(file, line);
+  if (line != getJobSignature()) {
+    std::cout << "Manifest was written for another job, starting from scratch" << std::endl;
+    return;
+  }
+
+  while (std::getline(file, line)) {
+    std::istringstream stream(line);
+    std::string key;
+    int frame;
+    if (!(stream >> key >> frame) || key != "frame" || frame < 0 || frame >= frameCount) { continue; }
+
+    std::ifstream image(getFramePath(frame));
+    if (image.good()) {
+      completedFrames.insert(frame);
+    }
+  }
+  std::cout << "Resuming: " << completedFrames.size() << "/" << frameCount << " frames already done" << std::endl;
+}
+
+// Time spent encoding the frames, reported at the end to choose the format
+std::atomic<long long> encodeMicroseconds(0);
+std::atomic<int> framesEncoded(0);
 
 // Save a frame
-void saveFrameAsPNG(Frame& frame) {
-  std::vector<unsigned char> data(SCREEN_WIDTH * SCREEN_HEIGHT * 3); // RGB only
-  
-  // Loop trough each tile, and copy pixels
-  int temp;
-  for (int i = 0; i < tileCount; i++) {
-    Tile& tile = frame.tiles[i];
-    for (int y = 0; y < tileHeight; y++) {
-      for (int x = 0; x < tileWidth; x++) {
-        int index = y * tileWidth + x;
-        temp = (y + tile.tileY * tileHeight) * SCREEN_WIDTH * 3 + (x + tile.tileX * tileWidth) * 3;
-        data[temp + 0] = tile.pixels[index].r;
-        data[temp + 1] = tile.pixels[index].g;
-        data[temp + 2] = tile.pixels[index].b;
+void saveFrame(Frame& frame) {
+  TraceScope trace("save", -1, frame.generation);
+  // Write to a temporary file first, so a killed run never leaves a truncated frame behind
+  std::string path = getFramePath(frame.generation);
+  // Named after the process, so workers sharing the directory (the straggler and its helper) never write the same temporary file
+  static const std::string tempSuffix = "." + FrameQueue::getOwnerName() + ".tmp";
+  std::string tempPath = path + tempSuffix;
+  // Reused by the next frame of the thread
+  thread_local std::string encoded;
+  auto encodeStart = std::chrono::steady_clock::now();
+  bool encodedOk;
+  {
+    TraceScope encodeTrace("encode", -1, frame.generation);
+    encodedOk = encodeImage(encoded, getImageFormatFromName(OUTPUT_FORMAT), (const unsigned char *) frame.pixels, SCREEN_WIDTH, SCREEN_HEIGHT,
+                            sizeof(Color), SCREEN_WIDTH * sizeof(Color), IMAGE_OPTIONS);
+  }
+  auto encodeTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - encodeStart).count();
+  encodeMicroseconds += encodeTime;
+  framesEncoded++;
+
+  FILE *file = encodedOk ? fopen(tempPath.c_str(), "wb") : nullptr;
+  bool written = file != nullptr && fwrite(encoded.data(), 1, encoded.size(), file) == encoded.size();
+  written = (file != nullptr && fclose(file) == 0) && written;
+  if (!written || std::rename(tempPath.c_str(), path.c_str()) != 0) {
+    std::cerr << "Could not write frame " << frame.generation << " to " << path << std::endl;
+    return;
+  }
+
+  // Only now is the frame complete (in queue mode, the frame files and the queue are the record)
+  if (QUEUE_DIR.empty()) {
+    std::lock_guard<std::mutex> lock(manifestMutex);
+    completedFrames.insert(frame.generation);
+    if (!writeManifest()) {
+      std::cerr << "Could not update " << getManifestPath() << std::endl;
+    }
+  }
+  printf("Saved frame %d (%s, encoded in %.1f ms, %.0f KB)\n", frame.generation, OUTPUT_FORMAT.c_str(), encodeTime / 1000.0, encoded.size() / 1024.0);
+  fflush(stdout);
+}
+
+void printEncodeSummary() {
+  if (framesEncoded == 0) { return; }
+  printf("Encoding: %.1f ms per frame on average (%s), %d frame buffer(s) allocated\n", encodeMicroseconds / 1000.0 / framesEncoded,
+         OUTPUT_FORMAT.c_str(), framePool.getAllocated());
+}
+
+// Camera and iterations of a frame, always on the same path whatever subset of the frames is rendered
+struct FrameView {
+  long double cx, cy, z;
+  float maxIterations;
+};
+FrameView getFrameView(int generation) {
+  FrameView view;
+  if (!plannedIterations.empty()) {
+    view.maxIterations = plannedIterations[generation];
+  } else {
+    view.maxIterations = MAX_ITERATIONS + (MAX_ITERATIONS_END - MAX_ITERATIONS) * (frameCount > 1 ? generation / (float) (frameCount - 1) : 0.0f);
+  }
+
+  // Find the keyframes around the frame
+  size_t next = 0;
+  while (next < path.size() && path[next].frame <= generation) { next++; }
+  if (next == 0 || next == path.size()) {
+    const Keyframe& keyframe = path[next == 0 ? 0 : path.size() - 1];
+    view.cx = keyframe.x;
+    view.cy = keyframe.y;
+    view.z = keyframe.zoom;
+    return view;
+  }
+  const Keyframe& from = path[next - 1];
+  const Keyframe& to = path[next];
+
+  // Zoom at a constant speed, and move the camera proportionally to the zoomed-out size of the view,
+  // so that the target of a zoom stays at the same place on screen
+  long double t = (generation - from.frame) / (long double) (to.frame - from.frame);
+  view.z = from.zoom * pow(to.zoom / from.zoom, t);
+  long double s = (from.zoom == to.zoom) ? t : (1 / from.zoom - 1 / view.z) / (1 / from.zoom - 1 / to.zoom);
+  view.cx = from.x + (to.x - from.x) * s;
+  view.cy = from.y + (to.y - from.y) * s;
+  return view;
+}
+
+// Frames are written atomically, so a frame is complete as soon as its file exists
+bool isFrameOnDisk(int generation) {
+  return access(getFramePath(generation).c_str(), F_OK) == 0;
+}
+
+// Sample the point at (offsetX, offsetY) from the camera, around the reference orbit if the job uses one
+template <typename Real>
+PointSample sampleFramePoint(long double cx, long double cy, long double offsetX, long double offsetY, float maxIterations) {
+  if (useReferenceOrbit) {
+    double dx = (double) (offsetX + (cx - referenceOrbit.getCenterX()));
+    double dy = (double) (offsetY + (cy - referenceOrbit.getCenterY()));
+    return samplePoint_MandelbrotPerturbed(referenceOrbit, dx, dy, maxIterations);
+  }
+  return samplePoint(SET, (Real) (cx + offsetX), (Real) (cy + offsetY), maxIterations, PARAMETERS);
+}
+
+// Automatic iterations
+// A low resolution probe of the frame tells how many pixels are still escaping near the end of the budget:
+// too many means the budget cuts details short, none means iterations are wasted on the inside of the set
+const int PROBE_WIDTH = 64;
+const int AUTO_ITERATIONS_SPACING = 12; // Frames between two probes, the frames in between are interpolated
+
+struct ProbeStats {
+  int pixels = 0;
+  int lateEscapes = 0;   // Escaped in the last half of the budget
+  float maxEscape = 0;   // Highest iteration count of an escaped pixel
+};
+
+template <typename Real>
+ProbeStats probeRows(const FrameView& view, float maxIterations, int probeHeight, int firstRow, int rowStep) {
+  ProbeStats stats;
+  for (int j = firstRow; j < probeHeight; j += rowStep) {
+    for (int i = 0; i < PROBE_WIDTH; i++) {
+      long double offsetX = ((i + 0.5L) * SCREEN_WIDTH / PROBE_WIDTH - SCREEN_WIDTH / 2.0) / view.z;
+      long double offsetY = ((j + 0.5L) * SCREEN_HEIGHT / probeHeight - SCREEN_HEIGHT / 2.0) / view.z;
+      PointSample sample = sampleFramePoint<Real>(view.cx, view.cy, offsetX, offsetY, maxIterations);
+
+      stats.pixels++;
+      if (sample.escaped) {
+        stats.maxEscape = std::max(stats.maxEscape, sample.n);
+        if (sample.n > maxIterations / 2) { stats.lateEscapes++; }
       }
     }
   }
+  return stats;
+}
 
-  char filename[64];
-  snprintf(filename, sizeof(filename), "frames/frame%05d.png", frame.generation);
-  stbi_write_png(filename, SCREEN_WIDTH, SCREEN_HEIGHT, 3, data.data(), SCREEN_WIDTH * 3);
-  std::cout << "Saved frame " << frame.generation << std::endl;
+ProbeStats probeFrame(const FrameView& view, float maxIterations) {
+  int probeHeight = std::max(1, PROBE_WIDTH * SCREEN_HEIGHT / SCREEN_WIDTH);
+
+  // Interleaved rows, so the threads get similar amounts of work
+  std::vector<ProbeStats> results(MAX_THREADS);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < MAX_THREADS; t++) {
+    workers.emplace_back([&, t]() {
+      switch (PRECISION) {
+        case PRECISION_FLOAT: results[t] = probeRows<float>(view, maxIterations, probeHeight, t, MAX_THREADS); break;
+        case PRECISION_DOUBLE: results[t] = probeRows<double>(view, maxIterations, probeHeight, t, MAX_THREADS); break;
+        default: results[t] = probeRows<long double>(view, maxIterations, probeHeight, t, MAX_THREADS); break;
+      }
+    });
+  }
+  for (auto& worker : workers) { worker.join(); }
+
+  ProbeStats total;
+  for (const ProbeStats& result : results) {
+    total.pixels += result.pixels;
+    total.lateEscapes += result.lateEscapes;
+    total.maxEscape = std::max(total.maxEscape, result.maxEscape);
+  }
+  return total;
 }
 
-// Compute a tile in the background
-void computeTileThread(Tile& tile, long double cx, long double cy, long double z, int generation, float maxIterations) {
-  // Add one to the thread counter
-  runningThreads.fetch_add(1, std::memory_order_relaxed);
+// Smallest budget for which the probe has (almost) no late escapes
+float findIterationBudget(const FrameView& view, float budget) {
+  while (true) {
+    if (useReferenceOrbit) { referenceOrbit.extend(budget); }
+    ProbeStats stats = probeFrame(view, budget);
+    if (stats.lateEscapes > ITERATIONS_TOLERANCE * stats.pixels && budget < AUTO_MAX_ITERATIONS) {
+      budget = std::min(budget * 2, (float) AUTO_MAX_ITERATIONS);
+      continue;
+    }
+
+    // The full frame has many more pixels than the probe, keep a margin above its slowest escape
+    return std::min(std::max(2 * stats.maxEscape, (float) MIN_ITERATIONS), (float) AUTO_MAX_ITERATIONS);
+  }
+}
+
+// Probe every few frames along the path, each probe starting from the budget of the previous one
+// Deterministic, so every process of a sharded job gets the same plan
+void planIterations() {
+  std::vector<int> anchors;
+  for (int i = 0; i < frameCount; i += AUTO_ITERATIONS_SPACING) { anchors.push_back(i); }
+  if (anchors.back() != frameCount - 1) { anchors.push_back(frameCount - 1); }
 
-  // Compute the pixels
-  std::vector<Color> pixels = std::vector<Color>(pixelCount);
-  for (int y = 0; y < tileHeight; y++) {
-    for (int x = 0; x < tileWidth; x++) {
-      long double posx = (x + tile.tileX * tileWidth - SCREEN_WIDTH / 2.0) / z + cx;
-      long double posy = (y + tile.tileY * tileHeight - SCREEN_HEIGHT / 2.0) / z + cy;
-      
-      pixels[y * tileWidth + x] = getColorFromPoint_Mandelbrot(posx, posy, maxIterations);
+  std::vector<float> budgets;
+  float budget = MIN_ITERATIONS;
+  for (const int anchor : anchors) {
+    FrameView view = getFrameView(anchor);
+
+    // Deeper views usually need more iterations, use that as a first guess
+    float depthGuess = 50 * pow(std::max(1.0L, log10l(view.z)), 1.5L);
+    budget = findIterationBudget(view, std::max(budget, depthGuess));
+    budgets.push_back(budget);
+  }
+
+  // Interpolate geometrically between the probes, so the palette doesn't jump from frame to frame
+  plannedIterations.resize(frameCount);
+  for (size_t k = 0; k < anchors.size(); k++) {
+    if (k + 1 == anchors.size()) {
+      plannedIterations[anchors[k]] = budgets[k];
+      break;
+    }
+    for (int i = anchors[k]; i < anchors[k + 1]; i++) {
+      float t = (i - anchors[k]) / (float) (anchors[k + 1] - anchors[k]);
+      plannedIterations[i] = std::round(budgets[k] * pow(budgets[k + 1] / budgets[k], t));
     }
   }
 
-  tile.pixels = pixels;
-  tile.hasComputed = true;
+  std::cout << "Iterations: " << budgets.front() << " on the first frame, " << budgets.back() << " on the last one, up to ";
+  std::cout << *std::max_element(budgets.begin(), budgets.end()) << std::endl;
+}
+
+// Save the frame once its last tile is computed
+void onTileRendered(const RenderView& view, const RenderTile& renderTile, const RenderStats& stats) {
+  Frame& frame = frames[renderTile.generation];
+  frame.tiles[renderTile.index].hasComputed = true;
+  if (frame.histogram != nullptr) {
+    frame.histogram->add(stats.worker, renderTile.samples, renderTile.width, renderTile.height, renderTile.sampleStride);
+  }
 
   // Lock frame to save
+  std::lock_guard<std::mutex> lock(frame.frameMutex);
+  frame.tilesComputed++;
+  if (frame.tilesComputed == tileCount) {
+    if (frame.histogram != nullptr) {
+      // Every sample of the frame is counted, color the whole frame with its histogram
+      RenderView recolored = view;
+      recolored.histogram = std::make_shared<const HistogramPalette>(frame.histogram->reduce(MAX_THREADS));
+      RenderTile whole;
+      whole.generation = frame.generation;
+      whole.width = SCREEN_WIDTH;
+      whole.height = SCREEN_HEIGHT;
+      whole.pixels = frame.pixels;
+      whole.samples = frame.samples.data();
+      recolorTile(recolored, whole);
+      std::vector<PointSample>().swap(frame.samples);
+      frame.histogram.reset();
+    }
+    saveFrame(frame);
+    frame.tilesComputed = 0;
+
+    // The pixels are on disk, the buffer can take the next frame
+    framePool.release(frame.pixels);
+    frame.pixels = nullptr;
+  }
+}
+
+// Compute a tile in the background
+void startTile(const PendingTile& pendingTile) {
+  Frame& frame = frames[pendingTile.generation];
+  Tile& tile = frame.tiles[pendingTile.index];
+  // Tiles are started in frame order, so only the frames being computed hold a buffer
   {
-    std::lock_guard<std::mutex> lock(frames[generation].frameMutex);
-    frames[generation].tilesComputed++;
-    if (frames[generation].tilesComputed == tileCount) {
-      saveFrameAsPNG(frames[generation]);
-      frames[generation].tilesComputed = 0;
+    std::lock_guard<std::mutex> lock(frame.frameMutex);
+    if (frame.pixels == nullptr) {
+      frame.pixels = framePool.acquire();
+      if (COLORING == COLORING_HISTOGRAM) {
+        frame.samples.resize(SCREEN_WIDTH * SCREEN_HEIGHT);
+        frame.histogram = std::make_unique<HistogramAccumulator>(pendingTile.maxIterations, renderPool->getThreadCount());
+      }
     }
   }
 
-  // Remove one from the thread counter
-  runningThreads.fetch_sub(1, std::memory_order_relaxed);
+  RenderView view;
+  view.set = SET;
+  view.parameters = PARAMETERS;
+  view.precision = PRECISION;
+  view.lanes = getPreferredLanes(SET, PRECISION);
+  view.cx = pendingTile.cx;
+  view.cy = pendingTile.cy;
+  view.zoom = pendingTile.z;
+  view.width = SCREEN_WIDTH;
+  view.height = SCREEN_HEIGHT;
+  view.maxIterations = pendingTile.maxIterations;
+  view.orbit = useReferenceOrbit ? &referenceOrbit : nullptr;
+  view.aaSamples = AA_SAMPLES;
+  view.coloring = COLORING;
+  view.interior = INTERIOR;
+
+  RenderTile renderTile;
+  renderTile.index = pendingTile.index;
+  renderTile.generation = pendingTile.generation;
+  renderTile.x = tile.tileX * tileWidth;
+  renderTile.y = tile.tileY * tileHeight;
+  renderTile.width = tileWidth;
+  renderTile.height = tileHeight;
+  renderTile.pixels = frame.pixels + renderTile.y * SCREEN_WIDTH + renderTile.x;
+  renderTile.stride = SCREEN_WIDTH;
+  if (!frame.samples.empty()) {
+    renderTile.samples = frame.samples.data() + renderTile.y * SCREEN_WIDTH + renderTile.x;
+    renderTile.sampleStride = SCREEN_WIDTH;
+  }
+  renderPool->submit(view, renderTile, onTileRendered);
 }
 
 // Launch all tile updates in parallel
@@ -142,26 +628,486 @@ void scheduleFrame(long double cx, long double cy, long double z, int generation
       PendingTile pendingTile = { i, cx, cy, z, generation, maxIterations };
       // Add tile to the queue
       pendingTiles.push_back(pendingTile);
+      traceInstant("enqueue", i, generation);
     };
 
     for (int i = 0; i < tileCount; i++) {
       scheduleTile(i);
     }
   } else {
-    // Compute all threads at the same time
-    std::vector<std::thread> workers;
+    // Compute all tiles at the same time
     for (int i = 0; i < tileCount; ++i) {
-      Tile& tile = frames[generation].tiles[i];
-      workers.emplace_back(computeTileThread, std::ref(tile), cx, cy, z, generation, maxIterations);
+      startTile({ i, cx, cy, z, generation, maxIterations });
+    }
+    renderPool->wait();
+  }
+}
+
+
+// Compute the given frames and wait for them to be saved, sending heartbeats to the queue chunk being worked on
+void renderFrames(const std::vector<int>& generations, FrameQueue *queue = nullptr, int chunk = -1) {
+  // No tile is being computed, so the orbit can grow to what these frames need
+  if (useReferenceOrbit) {
+    float maxIterations = 0;
+    for (const int generation : generations) {
+      maxIterations = std::max(maxIterations, getFrameView(generation).maxIterations);
+    }
+    referenceOrbit.extend(maxIterations);
+  }
+
+  size_t nextFrame = 0;
+  auto lastHeartbeat = std::chrono::steady_clock::now();
+  while (nextFrame < generations.size() || !pendingTiles.empty() || renderPool->getBusy() > 0) {
+    // Frames are scheduled once every tile of the previous ones has started, so the threads never run dry
+    // In queue mode a helper may have written the frame meanwhile, it is then skipped
+    while (pendingTiles.empty() && nextFrame < generations.size()) {
+      int generation = generations[nextFrame++];
+      if (queue != nullptr && isFrameOnDisk(generation)) { continue; }
+      FrameView view = getFrameView(generation);
+      traceInstant("frame", -1, generation);
+      scheduleFrame(view.cx, view.cy, view.z, generation, view.maxIterations);
+    }
+
+    // Keep every thread busy
+    while (renderPool->getBusy() < renderPool->getThreadCount() && !pendingTiles.empty()) {
+      PendingTile next = pendingTiles.front();
+      pendingTiles.pop_front();
+      traceInstant("dequeue", next.index, next.generation);
+      startTile(next);
+    }
+
+    // Tell the other workers that this chunk is still alive
+    auto now = std::chrono::steady_clock::now();
+    if (queue != nullptr && now - lastHeartbeat > std::chrono::seconds(HEARTBEAT_SECONDS)) {
+      queue->heartbeat(chunk);
+      lastHeartbeat = now;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+// Work on the shared queue until every chunk is done
+int runQueueWorker() {
+  FrameQueue queue;
+  queue.directory = QUEUE_DIR;
+  queue.frameCount = frameCount;
+  queue.chunkSize = CHUNK_SIZE;
+  queue.staleAfter = STALE_AFTER;
+  if (!queue.open(getJobSignature())) { return 1; }
+
+  while (true) {
+    // Render a free chunk in order
+    int chunk = queue.claimChunk();
+    bool helping = false;
+
+    // Nothing left to claim, help the slowest worker by rendering its chunk from the end
+    if (chunk < 0) {
+      chunk = queue.findStraggler();
+      helping = true;
+    }
+    if (chunk < 0) { break; }
+
+    std::vector<int> missing;
+    for (int i = queue.chunkBegin(chunk); i < queue.chunkEnd(chunk); i++) {
+      if (!isFrameOnDisk(i)) { missing.push_back(i); }
+    }
+
+    if (helping) {
+      // From the end, frame by frame, re-checking each time. The straggler also skips the frames already on disk when it gets to them,
+      // so they only both render the frames each of them had started when they meet
+      for (auto it = missing.rbegin(); it != missing.rend(); ++it) {
+        if (!isFrameOnDisk(*it)) { renderFrames({*it}); }
+      }
+    } else {
+      std::cout << "Rendering chunk " << chunk << " (" << missing.size() << " frames)" << std::endl;
+      renderFrames(missing, &queue, chunk);
+    }
+
+    // A frame that could not be written keeps the chunk claimed, its claim goes stale and another worker retries it
+    for (int i = queue.chunkBegin(chunk); i < queue.chunkEnd(chunk); i++) {
+      if (!isFrameOnDisk(i)) {
+        std::cerr << "Frame " << i << " of chunk " << chunk << " is missing, stopping" << std::endl;
+        return 1;
+      }
+    }
+    queue.markDone(chunk);
+  }
+
+  if (isTracing()) { writeTrace(); }
+  printEncodeSummary();
+  std::cout << "Done" << std::endl;
+  return 0;
+}
+
+// Spawn local workers on the queue (with the same flags), and respawn the ones that crash until the video is done
+int runCoordinator(int argc, char* argv[]) {
+  FrameQueue queue;
+  queue.directory = QUEUE_DIR;
+  queue.frameCount = frameCount;
+  queue.chunkSize = CHUNK_SIZE;
+  if (!queue.open(getJobSignature())) { return 1; }
+
+  // Same arguments, without --workers
+  std::vector<std::string> args;
+  for (int i = 0; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--workers") { i++; continue; }
+    args.push_back(arg);
+  }
+  args.push_back("--queue");
+  args.push_back(QUEUE_DIR);
+
+  auto spawnWorker = [&args]() {
+    pid_t pid = fork();
+    if (pid == 0) {
+      std::vector<char *> workerArgv;
+      for (auto &arg : args) { workerArgv.push_back(&arg[0]); }
+      workerArgv.push_back(nullptr);
+      execvp(workerArgv[0], workerArgv.data());
+      std::cerr << "Could not start worker " << workerArgv[0] << std::endl;
+      _exit(127);
+    }
+    return pid;
+  };
+
+  int running = 0;
+  for (int i = 0; i < WORKERS; i++) {
+    if (spawnWorker() > 0) { running++; }
+  }
+
+  // Bounded, so a worker that always crashes doesn't loop forever
+  int respawnsLeft = WORKERS * 3;
+  while (running > 0) {
+    int status;
+    pid_t pid = wait(&status);
+    if (pid < 0) { break; }
+    running--;
+
+    bool crashed = !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+    if (crashed && !queue.allDone() && respawnsLeft > 0) {
+      std::cerr << "Worker " << pid << " stopped unexpectedly, starting a new one" << std::endl;
+      respawnsLeft--;
+      if (spawnWorker() > 0) { running++; }
+    }
+  }
+
+  if (!queue.allDone()) {
+    std::cerr << "Some chunks are not done, run again to finish them" << std::endl;
+    return 1;
+  }
+  std::cout << "All workers done" << std::endl;
+  return 0;
+}
+
+
+// Apply one setting of the job (from a job file line or a flag), false if the value is invalid
+bool setJobOption(const std::string& key, const std::string& value) {
+  try {
+    if (key == "set") {
+      SET = getSetFromName(value);
+      return SET >= 0;
+    } else if (key == "julia-c") {
+      return parseComplex(value, PARAMETERS.juliaRe, PARAMETERS.juliaIm);
+    } else if (key == "phoenix-p") {
+      return parseComplex(value, PARAMETERS.phoenixRe, PARAMETERS.phoenixIm);
+    } else if (key == "lyapunov-sequence") {
+      return parseLyapunovSequence(value, PARAMETERS);
+    } else if (key == "lyapunov-warmup") {
+      PARAMETERS.lyapunovWarmup = std::stoi(value);
+      return PARAMETERS.lyapunovWarmup >= 0;
+    } else if (key == "precision") {
+      PRECISION = getPrecisionFromName(value);
+      return PRECISION >= 0;
+    } else if (key == "x") {
+      CAMERA_X = std::stold(value);
+    } else if (key == "y") {
+      CAMERA_Y = std::stold(value);
+    } else if (key == "zoom") {
+      zoom = std::stold(value);
+    } else if (key == "target-zoom") {
+      TARGET_ZOOM = std::stold(value);
+    } else if (key == "keyframe") {
+      Keyframe keyframe;
+      std::istringstream stream(value);
+      if (!(stream >> keyframe.frame >> keyframe.x >> keyframe.y >> keyframe.zoom)) { return false; }
+      keyframes.push_back(keyframe);
+    } else if (key == "width") {
+      SCREEN_WIDTH = std::stoi(value);
+    } else if (key == "height") {
+      SCREEN_HEIGHT = std::stoi(value);
+    } else if (key == "tiles-x") {
+      TILES_X = std::stoi(value);
+    } else if (key == "tiles-y") {
+      TILES_Y = std::stoi(value);
+    } else if (key == "fps") {
+      FPS = std::stoi(value);
+    } else if (key == "duration") {
+      DURATION = std::stoi(value);
+    } else if (key == "iterations") {
+      AUTO_ITERATIONS = value == "auto";
+      if (!AUTO_ITERATIONS) { MAX_ITERATIONS = std::stoi(value); }
+    } else if (key == "iterations-min") {
+      MIN_ITERATIONS = std::stoi(value);
+    } else if (key == "iterations-max") {
+      AUTO_MAX_ITERATIONS = std::stoi(value);
+    } else if (key == "iterations-tolerance") {
+      ITERATIONS_TOLERANCE = std::stof(value);
+    } else if (key == "iterations-end") {
+      MAX_ITERATIONS_END = std::stoi(value);
+    } else if (key == "output") {
+      OUTPUT_DIR = value;
+    } else if (key == "format") {
+      OUTPUT_FORMAT = value;
+    } else if (key == "png-level") {
+      IMAGE_OPTIONS.pngLevel = std::stoi(value);
+    } else if (key == "png-filter") {
+      IMAGE_OPTIONS.pngFilter = value == "auto" ? -1 : std::stoi(value);
+    } else if (key == "coloring") {
+      COLORING = getColoringFromName(value);
+      return COLORING >= 0;
+    } else if (key == "interior") {
+      INTERIOR = getInteriorFromName(value);
+      return INTERIOR >= 0;
+    } else if (key == "aa-samples") {
+      AA_SAMPLES = std::stoi(value);
+    } else if (key == "reference-orbit") {
+      REFERENCE_ORBIT = value;
+      return value == "auto" || value == "on" || value == "off";
+    } else if (key == "threads") {
+      int threads = std::stoi(value);
+      MAX_THREADS = threads > 0 ? threads : std::thread::hardware_concurrency();
+    } else {
+      return false;
+    }
+  } catch (const std::exception&) {
+    return false;
+  }
+  return true;
+}
+
+// Job files have one "key = value" per line, # starts a comment
+bool loadJobFile(const std::string& filename) {
+  std::ifstream file(filename);
+  if (!file.is_open()) {
+    std::cerr << "Could not open job file " << filename << std::endl;
+    return false;
+  }
+
+  auto trim = [](const std::string& text) {
+    size_t first = text.find_first_not_of(" \t\r");
+    size_t last = text.find_last_not_of(" \t\r");
+    return first == std::string::npos ? std::string() : text.substr(first, last - first + 1);
+  };
+
+  std::string line;
+  for (int lineNumber = 1; std::getline(file, line); lineNumber++) {
+    line = trim(line.substr(0, line.find('#')));
+    if (line.empty()) { continue; }
+
+    size_t equal = line.find('=');
+    std::string key = trim(line.substr(0, equal));
+    std::string value = equal == std::string::npos ? "" : trim(line.substr(equal + 1));
+    if (equal == std::string::npos || !setJobOption(key, value)) {
+      std::cerr << filename << ":" << lineNumber << ": invalid line \"" << line << "\"" << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+// Compute the values that depend on the job
+void computeDerivedValues() {
+  tileCount = TILES_X * TILES_Y;
+  tileWidth = SCREEN_WIDTH / TILES_X;
+  tileHeight = SCREEN_HEIGHT / TILES_Y;
+  frameCount = FPS * DURATION;
+  if (MAX_ITERATIONS_END < 0) { MAX_ITERATIONS_END = MAX_ITERATIONS; }
+
+  // Without keyframes, zoom from the first frame and reach the target zoom right after the last one
+  path = keyframes;
+  if (path.empty()) {
+    path.push_back({0, CAMERA_X, CAMERA_Y, zoom});
+    path.push_back({frameCount, CAMERA_X, CAMERA_Y, TARGET_ZOOM});
+  }
+  std::stable_sort(path.begin(), path.end(), [](const Keyframe& a, const Keyframe& b) { return a.frame < b.frame; });
+
+  // Perturbation only applies to the Mandelbrot set
+  bool doubleIsEnough = true;
+  for (const Keyframe& keyframe : path) {
+    doubleIsEnough = doubleIsEnough && isPrecisionEnough(PRECISION_DOUBLE, keyframe.x, keyframe.y, keyframe.zoom);
+  }
+  useReferenceOrbit = SET == SET_MANDELBROT && (REFERENCE_ORBIT == "on" || (REFERENCE_ORBIT == "auto" && !doubleIsEnough));
+}
+
+// Center the reference orbit on the deepest point of the path, the offsets of the shallow frames are large anyway
+bool openReferenceOrbit() {
+  const Keyframe *deepest = &path[0];
+  for (const Keyframe& keyframe : path) {
+    if (keyframe.zoom > deepest->zoom) { deepest = &keyframe; }
+  }
+
+  int capacity = AUTO_ITERATIONS ? AUTO_MAX_ITERATIONS : std::max(MAX_ITERATIONS, MAX_ITERATIONS_END);
+  if (CHECK_ONLY) {
+    return referenceOrbit.open(deepest->x, deepest->y, capacity, "");
+  }
+  if (!QUEUE_DIR.empty()) {
+    // Queue workers may share the output directory, each keeps its own spill file, removed once mapped
+    std::string orbitPath = OUTPUT_DIR + "/orbit-" + std::to_string((int) getpid()) + ".bin";
+    bool opened = referenceOrbit.open(deepest->x, deepest->y, capacity, orbitPath);
+    unlink(orbitPath.c_str());
+    return opened;
+  }
+  return referenceOrbit.open(deepest->x, deepest->y, capacity, getOrbitPath());
+}
+
+// Refuse jobs that can't be rendered, before spending hours on them
+bool validateJob() {
+  bool valid = true;
+  auto fail = [&valid](const std::string& message) {
+    std::cerr << "Invalid job: " << message << std::endl;
+    valid = false;
+  };
+
+  if (SCREEN_WIDTH <= 0 || SCREEN_HEIGHT <= 0 || TILES_X <= 0 || TILES_Y <= 0) {
+    fail("width, height, tiles-x and tiles-y must be positive");
+  } else if (SCREEN_WIDTH % TILES_X != 0 || SCREEN_HEIGHT % TILES_Y != 0) {
+    fail("width must be a multiple of tiles-x, and height a multiple of tiles-y");
+  }
+  if (frameCount <= 0) { fail("fps and duration must be positive"); }
+  if (MAX_ITERATIONS <= 0 || MAX_ITERATIONS_END <= 0) { fail("iterations must be positive"); }
+  if (AUTO_ITERATIONS && (MIN_ITERATIONS <= 0 || AUTO_MAX_ITERATIONS < MIN_ITERATIONS)) {
+    fail("iterations-min must be positive and not above iterations-max");
+  }
+  if (AUTO_ITERATIONS && SET == SET_LYAPUNOV) {
+    fail("automatic iterations need an escape-time set, Lyapunov always runs every iteration");
+  }
+  if (AA_SAMPLES < 0 || AA_SAMPLES > 64) { fail("aa-samples must be between 0 and 64"); }
+  if (getImageFormatFromName(OUTPUT_FORMAT) < 0) { fail("unknown format " + OUTPUT_FORMAT + " (png, qoi, ppm or pam)"); }
+  if (IMAGE_OPTIONS.pngLevel < 0 || IMAGE_OPTIONS.pngLevel > 9) { fail("png-level must be between 0 and 9"); }
+  if (IMAGE_OPTIONS.pngFilter < -1 || IMAGE_OPTIONS.pngFilter > 4) { fail("png-filter must be auto or between 0 and 4"); }
+
+  // The zoom only changes monotonically between keyframes, so checking them checks the whole path
+  for (const Keyframe& keyframe : path) {
+    if (keyframe.zoom <= 0) {
+      fail("zoom must be positive (frame " + std::to_string(keyframe.frame) + ")");
+      continue;
+    }
+
+    // With a reference orbit, only the orbit (in long double) needs the precision, offsets are fine in double
+    if (useReferenceOrbit) {
+      if (!isPrecisionEnough(PRECISION_LONG_DOUBLE, keyframe.x, keyframe.y, keyframe.zoom)) {
+        fail("the reference orbit is not precise enough at frame " + std::to_string(keyframe.frame));
+      }
+      continue;
+    }
+    if (!isPrecisionEnough(PRECISION, keyframe.x, keyframe.y, keyframe.zoom)) {
+      int needed = PRECISION;
+      while (needed < PRECISION_COUNT && !isPrecisionEnough(needed, keyframe.x, keyframe.y, keyframe.zoom)) { needed++; }
+
+      std::ostringstream message;
+      message << getPrecisionName(PRECISION) << " is not precise enough at frame " << keyframe.frame << " (zoom " << keyframe.zoom << "), ";
+      message << (needed < PRECISION_COUNT ? "use " + std::string(getPrecisionName(needed)) : std::string("no precision is enough that deep"));
+      fail(message.str());
     }
-    for (auto& t : workers) { t.join(); } // wait for all threads
   }
+
+  // Faster precisions are worth pointing out
+  if (valid && PRECISION > 0 && !useReferenceOrbit) {
+    bool lowerIsEnough = true;
+    for (const Keyframe& keyframe : path) {
+      lowerIsEnough = lowerIsEnough && isPrecisionEnough(PRECISION - 1, keyframe.x, keyframe.y, keyframe.zoom);
+    }
+    if (lowerIsEnough) {
+      std::cout << "Note: " << getPrecisionName(PRECISION - 1) << " would be precise enough for this job, and faster" << std::endl;
+    }
+  }
+  return valid;
 }
 
 
+// Whole number flag, false if the value is not one or is below minimum
+bool parseIntFlag(const std::string &value, int minimum, int &result) {
+  try {
+    size_t end;
+    int parsed = std::stoi(value, &end);
+    if (end != value.size() || parsed < minimum) { return false; }
+    result = parsed;
+  } catch (const std::exception&) {
+    return false;
+  }
+  return true;
+}
+
 // Main function
-int main() {
-  // Init the frames and tiles
+int main(int argc, char* argv[]) {
+  // Replace the job values by the ones given in the job file and the flags (if present), in order
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--job") {
+      if (!loadJobFile(argv[++i])) { return 1; }
+    } else if (arg == "--check") {
+      CHECK_ONLY = true;
+    } else if (arg == "--resume") {
+      RESUME = true;
+    } else if (arg == "--trace") {
+      TRACE_PATH = argv[++i];
+    } else if (arg == "--frames") {
+      if (sscanf(argv[++i], "%d-%d", &FIRST_FRAME, &LAST_FRAME) != 2) {
+        std::cerr << "--frames expects first-last" << std::endl;
+        return 1;
+      }
+    } else if (arg == "--shard") {
+      if (sscanf(argv[++i], "%d/%d", &SHARD_INDEX, &SHARD_COUNT) != 2 || SHARD_COUNT < 1 || SHARD_INDEX < 0 || SHARD_INDEX >= SHARD_COUNT) {
+        std::cerr << "--shard expects index/count, with 0 <= index < count" << std::endl;
+        return 1;
+      }
+    } else if (arg == "--queue") {
+      QUEUE_DIR = argv[++i];
+    } else if (arg == "--chunk-size" && i + 1 < argc) {
+      if (!parseIntFlag(argv[++i], 1, CHUNK_SIZE)) {
+        std::cerr << "--chunk-size expects a number of frames, at least 1" << std::endl;
+        return 1;
+      }
+    } else if (arg == "--stale-after" && i + 1 < argc) {
+      // Any shorter and live claims would look stale between two heartbeats
+      if (!parseIntFlag(argv[++i], MIN_STALE_AFTER, STALE_AFTER)) {
+        std::cerr << "--stale-after expects a number of seconds, at least " << MIN_STALE_AFTER << std::endl;
+        return 1;
+      }
+    } else if (arg == "--workers" && i + 1 < argc) {
+      if (!parseIntFlag(argv[++i], 0, WORKERS)) {
+        std::cerr << "--workers expects a number of processes, at least 0" << std::endl;
+        return 1;
+      }
+    } else if (arg.compare(0, 2, "--") == 0 && i + 1 < argc) {
+      // Any key of the job file
+      if (!setJobOption(arg.substr(2), argv[++i])) {
+        std::cerr << "Invalid flag " << arg << " " << argv[i] << std::endl;
+        return 1;
+      }
+    } else {
+      std::cerr << "Unknown flag " << arg << std::endl;
+      return 1;
+    }
+  }
+
+  computeDerivedValues();
+  if (!validateJob()) { return 1; }
+  // The coordinator doesn't render, its workers plan for themselves
+  if (useReferenceOrbit && WORKERS == 0) {
+    if (!openReferenceOrbit()) { return 1; }
+  }
+  if (AUTO_ITERATIONS && WORKERS == 0) {
+    planIterations();
+  }
+  if (CHECK_ONLY) {
+    std::cout << getJobDescription();
+    std::cout << frameCount << " frames of " << SCREEN_WIDTH << "x" << SCREEN_HEIGHT << " (" << getJobSignature() << ")" << std::endl;
+    return 0;
+  }
+  frames = std::vector<Frame>(frameCount);
+
+  // Init the frames and tiles (pixels are only allocated when a tile is computed)
   for (int i = 0; i < frameCount; i++) {
     Frame& frame = frames[i];
     frame.generation = i;
@@ -173,30 +1119,50 @@ int main() {
         tile.tileX = x;
         tile.tileY = y;
         tile.generation = i;
-        tile.pixels.resize(pixelCount);
       }
     }
   }
 
-  // Slowly ZOOM into the camera position, and schedule the frames
-  for (int i = 0; i < frameCount; i++) {
-    scheduleFrame(CAMERA_X, CAMERA_Y, zoom, i, MAX_ITERATIONS);
-    zoom *= zoomStep;
+  // The coordinator doesn't render, each of its workers writes its own trace
+  if (!TRACE_PATH.empty() && WORKERS == 0) {
+    startTrace(QUEUE_DIR.empty() ? TRACE_PATH : TRACE_PATH + "." + std::to_string((int) getpid()));
+    traceThreadName("main");
   }
 
+  // Distributed modes
+  if (WORKERS > 0) {
+    if (QUEUE_DIR.empty()) { QUEUE_DIR = OUTPUT_DIR + "/queue"; }
+    return runCoordinator(argc, argv);
+  }
+  renderPool = std::make_unique<RenderPool>(MAX_THREADS);
+  if (!QUEUE_DIR.empty()) {
+    return runQueueWorker();
+  }
 
-  // Do the threads
-  while (!pendingTiles.empty() || runningThreads.load(std::memory_order_relaxed) > 0) {
-    // Add the maximum of threads possible
-    while (runningThreads.load(std::memory_order_relaxed) < MAX_THREADS && !pendingTiles.empty()) {
-      PendingTile next = pendingTiles.front();
-      pendingTiles.pop_front();
+  // Find the frames that are already done, and start a new manifest otherwise
+  if (RESUME) {
+    loadManifest();
+  }
+  {
+    std::lock_guard<std::mutex> lock(manifestMutex);
+    if (!writeManifest()) {
+      std::cerr << "Could not write " << getManifestPath() << ", does the output directory exist?" << std::endl;
+      return 1;
+    }
+  }
 
-      Tile& tile = frames[next.generation].tiles[next.index];
-      std::thread(computeTileThread, std::ref(tile), next.cx, next.cy, next.z, next.generation, next.maxIterations).detach();
+  // Slowly ZOOM into the camera position, only rendering the frames of this shard that are not done yet
+  std::vector<int> generations;
+  int lastFrame = (LAST_FRAME >= 0 && LAST_FRAME < frameCount) ? LAST_FRAME : frameCount - 1;
+  for (int i = FIRST_FRAME; i <= lastFrame; i++) {
+    if (i % SHARD_COUNT == SHARD_INDEX && completedFrames.count(i) == 0) {
+      generations.push_back(i);
     }
   }
+  renderFrames(generations);
 
+  if (isTracing()) { writeTrace(); }
+  printEncodeSummary();
   std::cout << "Done" << std::endl;
   return 0;
 }
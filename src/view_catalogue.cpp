@@ -0,0 +1,27 @@
+#include "view_catalogue.hpp"
+
+
+// The Julia set of this c has no interior, its "interior" view is a slow part of the boundary instead
+const CatalogueView viewCatalogue[SET_COUNT][CATALOGUE_VIEW_COUNT] = {
+  // Mandelbrot
+  {{"shallow-exterior", -0.5L, 0.0L, 40}, {"boundary", 0.371751343412789317827L, -0.168184819942426289074L, 1e3L},
+   {"interior-heavy", -0.2L, 0.0L, 400}, {"deep-zoom", 0.371751343412789317827L, -0.168184819942426289074L, 1e9L}},
+  // Julia
+  {{"shallow-exterior", 0.0L, 0.0L, 40}, {"boundary", 0.76319871772271461282L, -0.139247978403814087756L, 1e3L},
+   {"interior-heavy", 0.76319871772271461282L, -0.139247978403814087756L, 1e6L}, {"deep-zoom", 0.76319871772271461282L, -0.139247978403814087756L, 1e9L}},
+  // Burning ship
+  {{"shallow-exterior", -0.5L, -0.5L, 40}, {"boundary", 0.25060928389510001398L, -0.0489511422575223953402L, 1e3L},
+   {"interior-heavy", -0.4L, -0.3L, 600}, {"deep-zoom", 0.25060928389510001398L, -0.0489511422575223953402L, 1e9L}},
+  // Tricorn
+  {{"shallow-exterior", 0.0L, 0.0L, 40}, {"boundary", 0.552310453843987939136L, -0.760416189329892522331L, 1e3L},
+   {"interior-heavy", -0.1L, 0.0L, 400}, {"deep-zoom", 0.552310453843987939136L, -0.760416189329892522331L, 1e9L}},
+  // Phoenix
+  {{"shallow-exterior", 0.0L, 0.0L, 40}, {"boundary", -0.206982856027387563831L, 0.445915314809379736971L, 1e3L},
+   {"interior-heavy", 0.1L, 0.0L, 400}, {"deep-zoom", -0.206982856027387563831L, 0.445915314809379736971L, 1e9L}},
+  // Lyapunov
+  {{"shallow-exterior", 3.0L, 3.0L, 40}, {"boundary", 3.4L, 3.6L, 200},
+   {"interior-heavy", 2.5L, 3.5L, 300}, {"deep-zoom", 3.4L, 3.6L, 1e6L}},
+  // Mandelbrot light effect
+  {{"shallow-exterior", -0.5L, 0.0L, 40}, {"boundary", 0.371751343412789317827L, -0.168184819942426289074L, 1e3L},
+   {"interior-heavy", -0.2L, 0.0L, 400}, {"deep-zoom", 0.371751343412789317827L, -0.168184819942426289074L, 1e9L}},
+};